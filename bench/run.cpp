@@ -46,6 +46,13 @@ int main() {
     }
     timer("getTile, found " + std::to_string(count) + " features");
 
+    count = 0;
+    index.generateAll(0, max_z - 1, [&](uint8_t, uint32_t, uint32_t,
+                                        const mapbox::geojsonvt::Tile& tile) {
+        count += tile.features.size();
+    });
+    timer("generateAll, found " + std::to_string(count) + " features");
+
     const std::string singleTileJson = loadFile("test/fixtures/single-tile.json");
     timer("read single tile file");
 
@@ -1,16 +1,33 @@
 #pragma once
 
+#include <mapbox/geojsonvt/budget.hpp>
 #include <mapbox/geojsonvt/convert.hpp>
+#include <mapbox/geojsonvt/memory.hpp>
+#include <mapbox/geojsonvt/observer.hpp>
+#include <mapbox/geojsonvt/requests.hpp>
+#include <mapbox/geojsonvt/snapshot.hpp>
+#include <mapbox/geojsonvt/sync.hpp>
 #include <mapbox/geojsonvt/tile.hpp>
+#include <mapbox/geojsonvt/tile_map.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 #include <mapbox/geojsonvt/wrap.hpp>
 
 #include <mapbox/feature.hpp>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <future>
 #include <map>
-#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 namespace mapbox {
 namespace geojsonvt {
@@ -48,7 +65,7 @@ struct TileOptions {
 };
 
 struct Options : TileOptions {
-    // max zoom to preserve detail on
+    // max zoom to preserve detail on; at most 29, the deepest zoom tiles can be ordered at
     uint8_t maxZoom = 18;
 
     // max zoom in the tile index
@@ -59,6 +76,41 @@ struct Options : TileOptions {
 
     // whether to generate feature ids, overriding existing ids  
     bool generateId = false;
+
+    // number of threads used to build the tile index (0 uses all available cores)
+    uint32_t threads = 1;
+
+    // store lines and polygons as flat point and offset arrays instead of nested vectors; not
+    // used together with lineMetrics
+    bool flatGeometry = false;
+
+    // max number of tiles above indexMaxZoom kept after drilling down to them; beyond it, the
+    // least recently used ones are dropped and rebuilt when requested again (0 keeps all)
+    uint32_t maxCachedTiles = 0;
+
+    // when drilling down below the index, only clip the tiles on the way to the requested one,
+    // instead of all four children at every zoom; tiles on the way keep their geometry, so that
+    // their other children can be drilled down to later
+    bool pathDrillDown = false;
+
+    // when drilling down from a tile whose point count times the number of requested tiles under
+    // it is at most this, clip its features straight to each requested tile, without making the
+    // tiles in between; the tile keeps its geometry for the next request, and polygon rings
+    // may start at another vertex than when cut one zoom at a time (0 never does)
+    uint32_t directDrillDownPoints = 0;
+
+    // limits for building the tile index: the number of tiles, an estimate of the bytes they hold
+    // (as memoryUsage counts them) and the time it takes, each 0 for none; once one is reached,
+    // tiles stop being split and keep their features to drill down from when requested, and
+    // degraded tells which one it was
+    uint32_t maxIndexTiles = 0;
+    uint64_t maxIndexBytes = 0;
+    uint32_t maxIndexMilliseconds = 0;
+
+#ifdef GEOJSONVT_OBSERVE
+    // receives the time and output size of every stage of building the index and its tiles
+    std::shared_ptr<Observer> observer;
+#endif
 };
 
 const Tile empty_tile{};
@@ -80,15 +132,16 @@ inline const Tile geoJSONToTile(const geojson& geojson_,
     auto tolerance = (options.tolerance / options.extent) / z2;
     auto features = detail::convert(features_, tolerance, false);
     if (wrap) {
-        features = detail::wrap(features, double(options.buffer) / options.extent, options.lineMetrics);
+        features = detail::wrap(std::move(features), double(options.buffer) / options.extent, options.lineMetrics);
     }
     if (clip || options.lineMetrics) {
         const double p = double(options.buffer) / options.extent;
 
-        const auto left = detail::clip<0>(features, (x - p) / z2, (x + 1 + p) / z2, -1, 2, options.lineMetrics);
-        features = detail::clip<1>(left, (y - p) / z2, (y + 1 + p) / z2, -1, 2, options.lineMetrics);
+        auto left = detail::clip<0>(std::move(features), (x - p) / z2, (x + 1 + p) / z2, -1, 2, options.lineMetrics);
+        features = detail::clip<1>(std::move(left), (y - p) / z2, (y + 1 + p) / z2, -1, 2, options.lineMetrics);
     }
-    return detail::InternalTile({ features, z, x, y, options.extent, tolerance, options.lineMetrics }).tile;
+    return detail::InternalTile({ features, z, x, y, options.extent, tolerance, options.lineMetrics })
+        .materialize(features);
 }
 
 class GeoJSONVT {
@@ -97,66 +150,1096 @@ public:
 
     GeoJSONVT(const mapbox::feature::feature_collection<double>& features_,
               const Options& options_ = Options())
-        : options(options_) {
+        : options(checked(options_)) {
 
+        detail::build_budget limits{ options.maxIndexTiles, options.maxIndexBytes,
+                                     options.maxIndexMilliseconds };
         const uint32_t z2 = 1u << options.maxZoom;
 
-        auto converted = detail::convert(features_, (options.tolerance / options.extent) / z2, options.generateId);
-        auto features = detail::wrap(converted, double(options.buffer) / options.extent, options.lineMetrics);
+        const detail::stage_timer converting(observer(), Stage::convert, 0, 0, 0);
+        auto converted = detail::convert(features_, (options.tolerance / options.extent) / z2,
+                                         options.generateId,
+                                         options.flatGeometry && !options.lineMetrics);
+        converting.done(converted);
+
+        const detail::stage_timer wrapping(observer(), Stage::wrap, 0, 0, 0);
+        auto features = detail::wrap(std::move(converted), double(options.buffer) / options.extent, options.lineMetrics);
+        wrapping.done(features);
 
-        splitTile(features, 0, 0, 0);
+        uint32_t threads = options.threads;
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        budget = &limits;
+        splitTile(std::move(features), 0, 0, 0, {}, threads);
+        budget = nullptr;
+        stoppedBy = limits.reached();
     }
 
     GeoJSONVT(const geojson& geojson_, const Options& options_ = Options())
         : GeoJSONVT(geojson::visit(geojson_, ToFeatureCollection{}), options_) {
     }
 
+    // tiles per zoom level and in total; not to be read while other threads call getTile, use
+    // tileCount for that
     std::map<uint8_t, uint32_t> stats;
     uint32_t total = 0;
 
-    const Tile& getTile(const uint8_t z, const uint32_t x_, const uint32_t y) {
+    // getTile and readTile may be called from several threads at once: requests for tiles that
+    // already exist only share a lock, and drilling down to new tiles runs outside of it, with
+    // requests that need the same parent tile waiting for a single drill-down; with
+    // maxCachedTiles set, the tile getTile returns may be evicted by another thread's request at
+    // any time, so use readTile instead
+    const Tile& getTile(const uint8_t z, const uint32_t x, const uint32_t y) {
+        const Tile* result = nullptr;
+        readTile(z, x, y, [&](const Tile& tile) { result = &tile; });
+        return *result;
+    }
+
+    // calls f with tile z/x/y while holding the index locked, so that the tile can't be evicted
+    // in the meantime; f must not call back into the index
+    template <class F>
+    void readTile(const uint8_t z, const uint32_t x_, const uint32_t y, F&& f) {
 
         if (z > options.maxZoom)
             throw std::runtime_error("Requested zoom higher than maxZoom: " + std::to_string(z));
 
+        const auto start = std::chrono::steady_clock::now();
         const uint32_t z2 = 1u << z;
         const uint32_t x = ((x_ % z2) + z2) % z2; // wrap tile x coordinate
         const uint64_t id = toID(z, x, y);
 
-        auto it = tiles.find(id);
-        if (it != tiles.end())
-            return it->second.tile;
+        {
+            std::shared_lock<detail::sharded_mutex> lock(mutex);
+            const auto it = tiles.find(id);
+            if (it != tiles.end()) {
+                if (evictable(z))
+                    cached.use(id);
+                const Tile& tile = it->second.tile();
+                requests.hit(z);
+                requests.took(z, start);
+                f(tile);
+                return;
+            }
+            if (empties.contains(z, x, y)) {
+                requests.empty(z);
+                requests.took(z, start);
+                f(empty_tile);
+                return;
+            }
+            if (const auto solid = solids.find(z, x, y)) {
+                requests.hit(z);
+                requests.took(z, start);
+                f(**solid);
+                return;
+            }
+        }
+
+        std::unique_lock<detail::sharded_mutex> lock(mutex);
+        drillDown(lock, { id }, [&](size_t, const Tile& tile) {
+            requests.took(z, start);
+            f(tile);
+        });
+    }
+
+    // returns copies of the tiles with the given ids (as made by toID), in the same order; missing
+    // tiles under a common ancestor are drilled down to together, slicing every tile on the way
+    // once, and different ancestors are sliced on up to threads threads (0 uses all cores)
+    std::vector<Tile> getTiles(const std::vector<uint64_t>& ids, uint32_t threads = 1) {
+        std::vector<Tile> result(ids.size());
+        std::vector<uint64_t> missing;
+        std::vector<size_t> positions;
+
+        for (const uint64_t id : ids) {
+            const uint8_t z = std::get<0>(detail::fromID(id));
+            if (z > options.maxZoom)
+                throw std::runtime_error("Requested zoom higher than maxZoom: " +
+                                         std::to_string(z));
+        }
+
+        {
+            std::shared_lock<detail::sharded_mutex> lock(mutex);
+            for (size_t i = 0; i < ids.size(); ++i) {
+                const auto it = tiles.find(ids[i]);
+                if (it == tiles.end()) {
+                    const uint8_t z = std::get<0>(detail::fromID(ids[i]));
+                    if (knownEmpty(ids[i])) {
+                        requests.empty(z);
+                        continue;
+                    }
+                    if (const auto solid = findSolid(ids[i])) {
+                        requests.hit(z);
+                        result[i] = **solid;
+                        continue;
+                    }
+                    missing.push_back(ids[i]);
+                    positions.push_back(i);
+                    continue;
+                }
+                if (evictable(it->second.z))
+                    cached.use(ids[i]);
+                requests.hit(it->second.z);
+                result[i] = it->second.tile();
+            }
+        }
+
+        if (missing.empty())
+            return result;
+
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        std::unique_lock<detail::sharded_mutex> lock(mutex);
+        drillDown(lock, missing, [&](size_t i, const Tile& tile) { result[positions[i]] = tile; },
+                  threads);
+
+        return result;
+    }
+
+    // calls sink(z, x, y, tile) for every tile with data from minZoom to maxZoom, in no particular
+    // order and from up to threads threads at once (0 uses all cores); tiles under the index are
+    // built without being added to it, and the geometry of each is dropped as soon as its
+    // children are cut from it, so memory use is bounded by the depth of the pyramid
+    template <class Sink>
+    void generateAll(const uint8_t minZoom, uint8_t maxZoom, Sink&& sink, uint32_t threads = 1) {
+        maxZoom = std::min(maxZoom, options.maxZoom);
+        if (threads == 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+        detail::work_queues<generate_job> jobs(threads);
+
+        {
+            std::unique_lock<detail::sharded_mutex> lock(mutex);
+            drilled.wait(lock, [&] { return drilling.empty(); });
+            collectJobs(0, 0, 0, minZoom, maxZoom, jobs);
+        }
+
+        jobs.run([&](const size_t worker, generate_job job) {
+            if (job.ready) {
+                sink(job.z, job.x, job.y, job.tile);
+                return;
+            }
+
+            if (job.solid) {
+                if (job.z >= minZoom)
+                    sink(job.z, job.x, job.y, *job.solid);
+                for (uint8_t i = 0; i < 4 && job.z < maxZoom; ++i) {
+                    jobs.push(worker, { static_cast<uint8_t>(job.z + 1), job.x * 2 + i / 2,
+                                        job.y * 2 + i % 2, {}, false, {}, job.solid });
+                }
+                return;
+            }
+
+            if (job.z >= minZoom) {
+                const double z2 = 1u << job.z;
+                const double tolerance =
+                    (job.z == options.maxZoom ? 0 : options.tolerance / (z2 * options.extent));
+                detail::InternalTile tile{ job.features, job.z, job.x, job.y, options.extent,
+                                           tolerance, options.lineMetrics };
+                observe(tile);
+                const auto& built = tile.materialize(job.features);
+                if (!built.features.empty())
+                    sink(job.z, job.x, job.y, built);
+            }
+
+            if (job.z == maxZoom)
+                return;
+
+            auto solid = detail::coveredTile(job.features, job.z, job.x, job.y, options.extent,
+                                             options.buffer);
+            if (solid) {
+                for (uint8_t i = 0; i < 4; ++i) {
+                    jobs.push(worker, { static_cast<uint8_t>(job.z + 1), job.x * 2 + i / 2,
+                                        job.y * 2 + i % 2, {}, false, {}, solid });
+                }
+                return;
+            }
+
+            auto children = quadrants(job.features, job.z, job.x, job.y);
+            job.features = {};
+
+            for (uint8_t i = 0; i < 4; ++i) {
+                if (children[i].empty())
+                    continue;
+                jobs.push(worker, { static_cast<uint8_t>(job.z + 1), job.x * 2 + i / 2,
+                                    job.y * 2 + i % 2, std::move(children[i]), false, {}, {} });
+            }
+        });
+    }
+
+    // builds tile z/x/y on another thread without blocking the caller: executor is called with a
+    // std::function<void()> that it should run on a thread of its own; tiles that already exist
+    // are returned right away, and requests for a tile that is still being built share its
+    // future; the index must outlive the returned futures
+    template <class Executor>
+    std::shared_future<Tile>
+    getTileAsync(const uint8_t z, const uint32_t x_, const uint32_t y, Executor&& executor) {
+
+        if (z > options.maxZoom)
+            throw std::runtime_error("Requested zoom higher than maxZoom: " + std::to_string(z));
+
+        const auto start = std::chrono::steady_clock::now();
+        const uint32_t x = x_ % (1u << z); // wrap tile x coordinate
+        const uint64_t id = toID(z, x, y);
+        const auto done = std::make_shared<std::promise<Tile>>();
+
+        {
+            std::shared_lock<detail::sharded_mutex> lock(mutex);
+            const auto it = tiles.find(id);
+            if (it != tiles.end()) {
+                if (evictable(z))
+                    cached.use(id);
+                done->set_value(it->second.tile());
+                requests.hit(z);
+                requests.took(z, start);
+                return done->get_future().share();
+            }
+            if (empties.contains(z, x, y)) {
+                done->set_value(empty_tile);
+                requests.empty(z);
+                requests.took(z, start);
+                return done->get_future().share();
+            }
+            if (const auto solid = solids.find(z, x, y)) {
+                done->set_value(**solid);
+                requests.hit(z);
+                requests.took(z, start);
+                return done->get_future().share();
+            }
+        }
+
+        std::shared_future<Tile> result;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            const auto it = pending.find(id);
+            if (it != pending.end())
+                return it->second;
+            result = pending.emplace(id, done->get_future().share()).first->second;
+        }
+
+        const auto finish = [this, id] {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            pending.erase(id);
+        };
+
+        try {
+            executor(std::function<void()>([this, z, x, y, done, finish] {
+                try {
+                    Tile tile;
+                    readTile(z, x, y, [&](const Tile& t) { tile = t; });
+                    finish();
+                    done->set_value(std::move(tile));
+                } catch (...) {
+                    finish();
+                    done->set_exception(std::current_exception());
+                }
+            }));
+        } catch (...) {
+            finish();
+            throw;
+        }
+
+        return result;
+    }
+
+    // add features to the index, clipping them into the tiles they fall in; returns the sorted ids
+    // (as made by toID) of the tiles that changed or were dropped, tiles under them that aren't in
+    // the index themselves may have changed too; tiles that getTile returned earlier are changed
+    // in place
+    std::vector<uint64_t> addFeatures(const feature_collection& features) {
+        return change({}, features);
+    }
+
+    // replace the features with the ids of the given ones, adding those that aren't in the index
+    std::vector<uint64_t> updateFeatures(const feature_collection& features) {
+        std::vector<mapbox::feature::identifier> ids;
+        for (const auto& feature : features) {
+            ids.push_back(feature.id);
+        }
+        return change(std::move(ids), features);
+    }
+
+    // remove the features with the given ids
+    std::vector<uint64_t> removeFeatures(std::vector<mapbox::feature::identifier> ids) {
+        return change(std::move(ids), {});
+    }
 
-        it = findParent(z, x, y);
+    // write the index, with its options, to a snapshot file that open serves tiles from without
+    // building the index again; replaces the file at once, so it may be saved over a snapshot
+    // that other processes are serving
+    void save(const std::string& path) {
+        std::unique_lock<detail::sharded_mutex> lock(mutex);
+        drilled.wait(lock, [&] { return drilling.empty(); });
 
-        if (it == tiles.end())
-            throw std::runtime_error("Parent tile not found");
+        detail::snapshot_writer writer;
+        writeOptions(writer.options(), options);
 
-        // if we found a parent tile containing the original geometry, we can drill down from it
-        const auto& parent = it->second;
+        for (const auto& pair : tiles) {
+            writer.addTile(pair.second);
+        }
+        for (size_t i = 0; i < snapshot.size(); ++i) {
+            if (snapshot.isTaken(i))
+                continue;
+            const auto tile = snapshot.coordinates(i);
+            writer.addTile(std::get<0>(tile), std::get<1>(tile), std::get<2>(tile),
+                           snapshot.read(i));
+        }
+        solids.each([&](const uint8_t z, const uint32_t x, const uint32_t y,
+                        const std::shared_ptr<const Tile>& tile) {
+            writer.addSolid(z, x, y, *tile);
+        });
+
+        writer.save(path);
+    }
+
+    // an index that serves the tiles of a snapshot file written by save, with the options it
+    // was saved with; the file is mapped into memory and each tile is read from it the first
+    // time it's needed, so stats, tileCount and the tile iteration functions only cover tiles
+    // read so far; the file must not be changed while the index uses it
+    static GeoJSONVT open(const std::string& path) {
+        detail::snapshot file(path);
+        auto in = file.options();
+        GeoJSONVT index{ checked(readOptions(in)) };
+        std::vector<uint64_t> covered;
+        file.eachSolid([&](const uint8_t z, const uint32_t x, const uint32_t y,
+                           std::shared_ptr<const Tile> tile) {
+            index.solids.insert(z, x, y, std::move(tile));
+            covered.push_back(toID(z, x, y));
+        });
+        index.snapshot = std::move(file);
+
+        // the top tile of a covered subtree was built from its own features, unlike the tiles
+        // under it, so it's read right away rather than answered with the shared tile
+        for (const uint64_t id : covered) {
+            index.findTile(id);
+        }
+        return index;
+    }
+
+    // number of tiles in the index, in total or at zoom z; may be called at any time
+    uint32_t tileCount() const {
+        return counts.total();
+    }
 
-        // drill down parent tile up to the requested one
-        splitTile(parent.source_features, parent.z, parent.x, parent.y, z, x, y);
+    uint32_t tileCount(const uint8_t z) const {
+        return counts.get(z);
+    }
+
+    // the limit in options that stopped building the index before indexMaxZoom, if any; the tiles
+    // it stopped at are drilled down from like those at indexMaxZoom
+    BuildLimit degraded() const {
+        return stoppedBy;
+    }
+
+    // how the tiles requested so far were answered, in total and per zoom level, with the time
+    // getTile, readTile and getTileAsync took for them; getTiles counts its tiles but not its
+    // time; may be called at any time
+    RequestStats requestStats() const {
+        return requests.stats();
+    }
 
-        it = tiles.find(id);
-        if (it != tiles.end())
-            return it->second.tile;
+    // an estimate of the memory the tiles of the index hold, in total, per zoom level and for the
+    // given number of tiles that hold the most; geometry and properties shared between tiles count
+    // for the top tile they're in; holds the index locked while it counts
+    MemoryUsage memoryUsage(const size_t heaviest = 10) const {
+        std::lock_guard<detail::sharded_mutex> lock(mutex);
+        MemoryUsage usage;
+        detail::memory_counter counter;
+        std::vector<TileMemory> measured;
 
-        it = findParent(z, x, y);
-        if (it == tiles.end())
-            throw std::runtime_error("Parent tile not found");
+        tiles.eachDescendant(0, 0, 0, [&](const auto& pair) {
+            const auto& tile = pair.second;
+            const MemoryBytes bytes = counter.measure(pair);
+            usage.total += bytes;
+            usage.zooms[tile.z] += bytes;
+            measured.push_back({ tile.z, tile.x, tile.y, bytes });
+        });
 
-        return empty_tile;
+        solids.each([&](uint8_t, uint32_t, uint32_t, const std::shared_ptr<const Tile>& tile) {
+            usage.total.features += sizeof(Tile) + detail::heapBytes(*tile);
+        });
+        usage.total.overhead += tiles.tableBytes() + empties.bytes() + solids.bytes();
+
+        const auto heavier = [](const TileMemory& a, const TileMemory& b) {
+            return a.bytes.total() > b.bytes.total();
+        };
+        const size_t n = std::min(heaviest, measured.size());
+        std::partial_sort(measured.begin(), measured.begin() + n, measured.end(), heavier);
+        measured.resize(n);
+        usage.heaviest = std::move(measured);
+        return usage;
     }
 
-    const std::unordered_map<uint64_t, detail::InternalTile>& getInternalTiles() const {
+    // not to be used while other threads call getTile
+    const detail::tile_map<detail::InternalTile>& getInternalTiles() const {
         return tiles;
     }
 
+    // calls f with the generated tile z/x/y, if any, and every generated tile under it, in Z-order;
+    // holds the index locked, so f must not call back into it
+    template <class F>
+    void forEachDescendant(const uint8_t z, const uint32_t x, const uint32_t y, F&& f) const {
+        std::lock_guard<detail::sharded_mutex> lock(mutex);
+        tiles.eachDescendant(z, x, y, [&](const auto& pair) { f(pair.second); });
+    }
+
+    // calls f with every generated tile at zoom z within [minX, maxX] x [minY, maxY], in Z-order;
+    // holds the index locked, so f must not call back into it
+    template <class F>
+    void forEachTileInRange(const uint8_t z,
+                            const uint32_t minX,
+                            const uint32_t minY,
+                            const uint32_t maxX,
+                            const uint32_t maxY,
+                            F&& f) const {
+        std::lock_guard<detail::sharded_mutex> lock(mutex);
+        tiles.eachInRange(z, minX, minY, maxX, maxY, [&](const auto& pair) { f(pair.second); });
+    }
+
 private:
-    std::unordered_map<uint64_t, detail::InternalTile> tiles;
+    detail::tile_map<detail::InternalTile> tiles;
+
+    // drilled down tiles that may be evicted, when maxCachedTiles is set
+    detail::tile_lru cached;
+
+    // tiles found to have no data, together with everything under them; requests for tiles in
+    // there are answered with empty_tile right away, without looking for a parent
+    detail::tile_ranges<> empties;
+
+    // tiles covered by polygons and everything under them, which all share one output tile
+    detail::tile_ranges<std::shared_ptr<const Tile>> solids;
+
+    // readers of tiles take it shared, anything adding or removing tiles takes it exclusively
+    mutable detail::fresh<detail::sharded_mutex> mutex;
+
+    // tiles being drilled down from outside of the lock, and a signal for when one is done
+    std::vector<uint64_t> drilling;
+    detail::fresh<std::condition_variable_any> drilled;
+
+    // tiles requested with getTileAsync that are still being built
+    detail::tile_map<std::shared_future<Tile>> pending;
+    detail::fresh<std::mutex> pendingMutex;
+
+    // tile counts that stay readable while other threads add tiles
+    detail::tile_counters counts;
+
+    // how tile requests were answered, and how long they took
+    detail::fresh<detail::request_counters> requests;
+
+    // the file an index opened with open reads its tiles from
+    detail::snapshot snapshot;
+
+    // what building the index may still use, while it's being built
+    detail::build_budget* budget = nullptr;
+    BuildLimit stoppedBy = BuildLimit::none;
+
+    // an empty index that only holds options; used to build subtrees on worker threads
+    explicit GeoJSONVT(const Options& options_) : options(options_) {
+    }
+
+    // the given options, if an index can be built with them
+    static const Options& checked(const Options& o) {
+        if (o.maxZoom > detail::z_order_max_zoom)
+            throw std::runtime_error("maxZoom higher than " +
+                                     std::to_string(detail::z_order_max_zoom) + ": " +
+                                     std::to_string(o.maxZoom));
+#ifdef GEOJSONVT_COMPACT_POINTS
+        // a unit of a tile at maxZoom has to be one the fixed-point coordinates can tell apart
+        if ((uint64_t(o.extent) << o.maxZoom) > (uint64_t(1) << detail::vt_fixed::fraction_bits))
+            throw std::runtime_error("extent " + std::to_string(o.extent) + " at maxZoom " +
+                                     std::to_string(o.maxZoom) +
+                                     " finer than compact points can represent");
+#endif
+        return o;
+    }
+
+    // move the tiles of an independently built subtree into this index; tiles that this index
+    // already has are kept
+    void merge(GeoJSONVT&& subtree) {
+        for (const auto& pair : subtree.tiles) {
+            if (tiles.count(pair.first) == 0)
+                added(pair.first, pair.second.z);
+        }
+        tiles.merge(std::move(subtree.tiles));
+        solids.merge(subtree.solids);
+    }
+
+    void added(const uint64_t id, const uint8_t z) {
+        stats[z] = (stats.count(z) ? stats[z] + 1 : 1);
+        total++;
+        counts.add(z);
+        if (evictable(z))
+            cached.touch(id);
+
+        // from now on the tile in the index replaces the one in the snapshot
+        if (!snapshot.empty()) {
+            uint32_t x;
+            uint32_t y;
+            std::tie(std::ignore, x, y) = detail::fromID(id);
+            const size_t i = snapshot.find(z, x, y);
+            if (i != detail::snapshot::npos)
+                snapshot.take(i);
+        }
+    }
+
+    // the tile with the given id, read from the snapshot if the index was opened from one and
+    // doesn't have it yet
+    detail::tile_map<detail::InternalTile>::iterator findTile(const uint64_t id) {
+        auto it = tiles.find(id);
+        if (it != tiles.end() || snapshot.empty())
+            return it;
+
+        uint8_t z;
+        uint32_t x;
+        uint32_t y;
+        std::tie(z, x, y) = detail::fromID(id);
+        const size_t i = snapshot.find(z, x, y);
+        if (i == detail::snapshot::npos)
+            return it;
+
+        auto saved = snapshot.read(i);
+        const double z2 = 1u << z;
+        const double tolerance =
+            (z == options.maxZoom ? 0 : options.tolerance / (z2 * options.extent));
+        it = tiles
+                 .emplace(id, detail::InternalTile{ saved.features, z, x, y, options.extent,
+                                                    tolerance, options.lineMetrics })
+                 .first;
+        auto& tile = it->second;
+        observe(tile);
+        tile.source_features = std::move(saved.features);
+        tile.num_points = saved.num_points;
+        tile.bbox = saved.bbox;
+        if (saved.sliced)
+            tile.restore(std::move(saved.output), std::move(saved.points));
+        added(id, z);
+        return it;
+    }
+
+    static void writeOptions(detail::byte_writer& out, const Options& o) {
+        out.put(o.tolerance);
+        out.put(o.extent);
+        out.put(o.buffer);
+        out.put(static_cast<uint8_t>(o.lineMetrics));
+        out.put(o.maxZoom);
+        out.put(o.indexMaxZoom);
+        out.put(o.indexMaxPoints);
+        out.put(static_cast<uint8_t>(o.generateId));
+        out.put(o.threads);
+        out.put(static_cast<uint8_t>(o.flatGeometry));
+        out.put(o.maxCachedTiles);
+        out.put(static_cast<uint8_t>(o.pathDrillDown));
+        out.put(o.directDrillDownPoints);
+        out.put(o.maxIndexTiles);
+        out.put(o.maxIndexBytes);
+        out.put(o.maxIndexMilliseconds);
+    }
+
+    static Options readOptions(detail::byte_reader& in) {
+        Options o;
+        o.tolerance = in.get<double>();
+        o.extent = in.get<uint16_t>();
+        o.buffer = in.get<uint16_t>();
+        o.lineMetrics = in.get<uint8_t>() != 0;
+        o.maxZoom = in.get<uint8_t>();
+        o.indexMaxZoom = in.get<uint8_t>();
+        o.indexMaxPoints = in.get<uint32_t>();
+        o.generateId = in.get<uint8_t>() != 0;
+        o.threads = in.get<uint32_t>();
+        o.flatGeometry = in.get<uint8_t>() != 0;
+        o.maxCachedTiles = in.get<uint32_t>();
+        o.pathDrillDown = in.get<uint8_t>() != 0;
+        o.directDrillDownPoints = in.get<uint32_t>();
+        o.maxIndexTiles = in.get<uint32_t>();
+        o.maxIndexBytes = in.get<uint64_t>();
+        o.maxIndexMilliseconds = in.get<uint32_t>();
+        return o;
+    }
+
+    // whether drilled down tiles at zoom z are subject to maxCachedTiles
+    bool evictable(const uint8_t z) const {
+        return options.maxCachedTiles != 0 && z > options.indexMaxZoom;
+    }
+
+    // whether a tile at zoom z keeps its source features after drilling down from it
+    bool keepsSource(const uint8_t z) const {
+        return options.pathDrillDown ||
+               (options.maxCachedTiles != 0 && z <= options.indexMaxZoom);
+    }
+
+    // whether drilling down from a tile with the given number of points to count tiles under it
+    // is cheap enough to clip its features straight to each of them
+    bool clipsDirectly(const uint32_t numPoints, const size_t count) const {
+        return options.directDrillDownPoints != 0 &&
+               uint64_t(numPoints) * count <= options.directDrillDownPoints;
+    }
+
+    // where the stages of building tiles are reported, if anywhere
+    Observer* observer() const {
+#ifdef GEOJSONVT_OBSERVE
+        return options.observer.get();
+#else
+        return nullptr;
+#endif
+    }
+
+    // count the bytes a tile of the index being built holds against maxIndexBytes, once it's done
+    template <class Value>
+    void charge(const Value& pair) {
+        if (budget && options.maxIndexBytes)
+            budget->charge(detail::memory_counter().measure(pair).total());
+    }
+
+    void observe(detail::InternalTile& tile) const {
+#ifdef GEOJSONVT_OBSERVE
+        tile.observer = options.observer.get();
+#else
+        (void)tile;
+#endif
+    }
+
+    bool knownEmpty(const uint64_t id) const {
+        uint8_t z;
+        uint32_t x;
+        uint32_t y;
+        std::tie(z, x, y) = detail::fromID(id);
+        return empties.contains(z, x, y);
+    }
+
+    const std::shared_ptr<const Tile>* findSolid(const uint64_t id) const {
+        uint8_t z;
+        uint32_t x;
+        uint32_t y;
+        std::tie(z, x, y) = detail::fromID(id);
+        return solids.find(z, x, y);
+    }
+
+    bool isDrilling(const uint64_t id) const {
+        return std::find(drilling.begin(), drilling.end(), id) != drilling.end();
+    }
+
+    // find or build the tiles with the given ids, calling visit with the position of each in ids
+    // and the tile; missing tiles are built from their closest ancestor that still has its
+    // geometry, slicing each such ancestor once for all of the requested tiles under it; the
+    // slicing happens in separate indexes, on up to threads threads, with the lock released
+    template <class Visit>
+    void drillDown(std::unique_lock<detail::sharded_mutex>& lock,
+                   const std::vector<uint64_t>& ids,
+                   Visit&& visit,
+                   const uint32_t threads = 1) {
+
+        struct drill {
+            uint64_t id;
+            uint8_t z;
+            uint32_t x;
+            uint32_t y;
+            std::vector<uint64_t> targets; // Z-order keys of the tiles to drill down to
+            std::vector<uint64_t> ids;     // ids of the same tiles, in request order
+            bool direct;
+            detail::vt_features features;
+        };
+
+        std::vector<size_t> missing(ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            missing[i] = i;
+        }
+
+        // the zoom levels between each tile and the parent it was last drilled down from
+        std::vector<uint8_t> levels(ids.size(), 0);
+        const auto answered = [&](const size_t i, const uint8_t z, const bool empty) {
+            if (levels[i] > 0)
+                requests.drilled(z, levels[i]);
+            else if (empty)
+                requests.empty(z);
+            else
+                requests.hit(z);
+        };
+
+        while (!missing.empty()) {
+            std::vector<drill> drills;
+            std::vector<size_t> remaining;
+            bool blocked = false;
+
+            for (const size_t i : missing) {
+                auto it = findTile(ids[i]);
+                if (it != tiles.end()) {
+                    if (evictable(it->second.z))
+                        cached.touch(ids[i]);
+                    answered(i, it->second.z, false);
+                    visit(i, it->second.tile());
+                    continue;
+                }
+
+                uint8_t z;
+                uint32_t x;
+                uint32_t y;
+                std::tie(z, x, y) = detail::fromID(ids[i]);
 
-    std::unordered_map<uint64_t, detail::InternalTile>::iterator
+                if (empties.contains(z, x, y)) {
+                    answered(i, z, true);
+                    visit(i, empty_tile);
+                    continue;
+                }
+                if (const auto solid = solids.find(z, x, y)) {
+                    answered(i, z, false);
+                    visit(i, **solid);
+                    continue;
+                }
+
+                it = findParent(z, x, y);
+
+                if (it == tiles.end())
+                    throw std::runtime_error("Parent tile not found");
+
+                // an empty tile, there is nothing to drill down into, now or later
+                auto& parent = it->second;
+                if (parent.source_features.empty() && !isDrilling(it->first)) {
+                    empties.insert(parent.z, parent.x, parent.y);
+                    answered(i, z, true);
+                    visit(i, empty_tile);
+                    continue;
+                }
+
+                remaining.push_back(i);
+                levels[i] = static_cast<uint8_t>(z - parent.z);
+
+                const auto sameParent = [&](const drill& d) { return d.id == it->first; };
+                const auto d = std::find_if(drills.begin(), drills.end(), sameParent);
+                if (d != drills.end()) {
+                    d->targets.push_back(detail::zOrderKey(z, x, y));
+                    d->ids.push_back(ids[i]);
+
+                } else if (isDrilling(it->first)) {
+                    // another thread is already drilling down from this parent; wait for it
+                    blocked = true;
+
+                } else {
+                    const uint64_t key = detail::zOrderKey(z, x, y);
+                    drills.push_back(
+                        { it->first, parent.z, parent.x, parent.y, { key }, { ids[i] }, false, {} });
+                }
+            }
+
+            trim();
+            missing = std::move(remaining);
+
+            if (drills.empty()) {
+                if (blocked)
+                    drilled.wait(lock);
+                continue;
+            }
+
+            // the parent is always sliced further, so it doesn't need to keep its source
+            // geometry, unless it's an index tile that evicted tiles may have to be rebuilt from,
+            // or the tiles are clipped from it directly, leaving no tiles in between
+            for (auto& d : drills) {
+                auto& parent = tiles.find(d.id)->second;
+                d.direct = clipsDirectly(parent.num_points, d.ids.size());
+                if (d.direct || keepsSource(d.z)) {
+                    d.features = parent.source_features;
+                } else {
+                    parent.tile(); // build it while its features are still there
+                    d.features = std::move(parent.source_features);
+                    parent.source_features = {};
+                }
+                std::sort(d.targets.begin(), d.targets.end());
+                drilling.push_back(d.id);
+            }
+
+            lock.unlock();
+
+            std::vector<GeoJSONVT> subtrees;
+            try {
+                subtrees = sliceAll(drills, threads);
+            } catch (...) {
+                lock.lock();
+                finishDrills(drills);
+                throw;
+            }
+
+            lock.lock();
+            for (auto& subtree : subtrees) {
+                merge(std::move(subtree));
+            }
+            finishDrills(drills);
+        }
+    }
+
+    // a tile for generateAll: either the geometry to build it and the tiles under it from, a copy
+    // of it when it was already sliced further in the index, or the tile that it and every tile
+    // under it are when it's covered by polygons
+    struct generate_job {
+        uint8_t z = 0;
+        uint32_t x = 0;
+        uint32_t y = 0;
+        detail::vt_features features;
+        bool ready = false;
+        Tile tile;
+        std::shared_ptr<const Tile> solid;
+    };
+
+    void collectJobs(const uint8_t z,
+                     const uint32_t x,
+                     const uint32_t y,
+                     const uint8_t minZoom,
+                     const uint8_t maxZoom,
+                     detail::work_queues<generate_job>& jobs) {
+        const auto it = findTile(toID(z, x, y));
+        if (it == tiles.end()) {
+            // there was nothing here, or the tile was evicted while its parent stayed; in that
+            // case cut it again from the closest tile above that has its geometry, as getTile
+            // would (index tiles keep theirs while tiles can be evicted, so that one is usually
+            // made into a job before we get here)
+            if (!evictable(z) || empties.contains(z, x, y))
+                return;
+            const auto parent = findParent(z, x, y);
+            if (parent == tiles.end() || parent->second.source_features.empty())
+                return;
+            auto features = parent->second.source_features;
+            for (uint8_t pz = parent->second.z; pz < z && !features.empty(); ++pz) {
+                const uint32_t cx = x >> (z - pz - 1);
+                const uint32_t cy = y >> (z - pz - 1);
+                features = quadrant(features, pz, cx / 2, cy / 2, (cx % 2) * 2 + cy % 2);
+            }
+            if (!features.empty())
+                jobs.push(0, { z, x, y, std::move(features), false, {}, {} });
+            return;
+        }
+
+        const auto& tile = it->second;
+        if (!tile.source_features.empty()) {
+            jobs.push(0, { z, x, y, tile.source_features, false, {}, {} });
+            return;
+        }
+
+        if (z >= minZoom && !tile.tile().features.empty())
+            jobs.push(0, { z, x, y, {}, true, tile.tile(), {} });
+
+        if (z == maxZoom)
+            return;
+
+        // nothing was made under a covered tile, every tile there is the same square
+        if (const auto solid = solids.find(z, x, y)) {
+            for (uint8_t i = 0; i < 4; ++i) {
+                jobs.push(0, { static_cast<uint8_t>(z + 1), x * 2 + i / 2, y * 2 + i % 2, {}, false,
+                               {}, *solid });
+            }
+            return;
+        }
+
+        for (uint8_t i = 0; i < 4; ++i) {
+            collectJobs(z + 1, x * 2 + i / 2, y * 2 + i % 2, minZoom, maxZoom, jobs);
+        }
+    }
+
+    // slice each of the given parents down to its targets into an index of its own
+    template <class Drill>
+    std::vector<GeoJSONVT> sliceAll(std::vector<Drill>& drills, const uint32_t threads) const {
+        const auto slice = [this](Drill& d) {
+            const detail::stage_timer drilling(observer(), Stage::drillDown, d.z, d.x, d.y);
+            GeoJSONVT subtree{ options };
+            if (d.direct)
+                subtree.clipTiles(d.features, d.ids, d.targets);
+            else
+                subtree.sliceTile(std::move(d.features), d.z, d.x, d.y, d.targets);
+
+            uint8_t deepest = d.z;
+            for (const uint64_t id : d.ids) {
+                deepest = std::max(deepest, std::get<0>(detail::fromID(id)));
+            }
+            drilling.done(subtree.total, 0, deepest - d.z);
+            return subtree;
+        };
+
+        std::vector<GeoJSONVT> subtrees;
+
+        if (threads > 1 && drills.size() > 1) {
+            const size_t workers = std::min<size_t>(threads, drills.size());
+            std::vector<std::future<std::vector<GeoJSONVT>>> results;
+
+            for (size_t w = 0; w < workers; ++w) {
+                results.push_back(std::async(std::launch::async, [&, w] {
+                    std::vector<GeoJSONVT> built;
+                    for (size_t i = w; i < drills.size(); i += workers) {
+                        built.push_back(slice(drills[i]));
+                    }
+                    return built;
+                }));
+            }
+
+            for (auto& result : results) {
+                for (auto& subtree : result.get()) {
+                    subtrees.push_back(std::move(subtree));
+                }
+            }
+
+        } else {
+            for (auto& d : drills) {
+                subtrees.push_back(slice(d));
+            }
+        }
+
+        return subtrees;
+    }
+
+    // let threads waiting for the given parents know they were sliced
+    template <class Drill>
+    void finishDrills(const std::vector<Drill>& drills) {
+        for (const auto& d : drills) {
+            drilling.erase(std::find(drilling.begin(), drilling.end(), d.id));
+        }
+        drilled.notify_all();
+    }
+
+    void trim() {
+        while (cached.size() > options.maxCachedTiles) {
+            removed(cached.pop());
+        }
+    }
+
+    void removed(const uint64_t id) {
+        const uint8_t z = tiles.find(id)->second.z;
+        tiles.erase(id);
+        if (--stats[z] == 0)
+            stats.erase(z);
+        total--;
+        counts.remove(z);
+    }
+
+    // remove the features with the given ids and add the given features, in every tile they are in
+    std::vector<uint64_t> change(std::vector<mapbox::feature::identifier> ids,
+                                 const feature_collection& features_) {
+        if (options.generateId)
+            throw std::runtime_error("Features can't be changed when generateId is set");
+
+        // features without an id can be added, but not found again
+        const auto unset = [](const mapbox::feature::identifier& id) {
+            return id.is<mapbox::feature::null_value_t>();
+        };
+        ids.erase(std::remove_if(ids.begin(), ids.end(), unset), ids.end());
+        std::sort(ids.begin(), ids.end());
+
+        const uint32_t z2 = 1u << options.maxZoom;
+        const detail::stage_timer converting(observer(), Stage::convert, 0, 0, 0);
+        auto converted = detail::convert(features_, (options.tolerance / options.extent) / z2, false,
+                                         options.flatGeometry && !options.lineMetrics);
+        converting.done(converted);
+
+        const detail::stage_timer wrapping(observer(), Stage::wrap, 0, 0, 0);
+        auto features = detail::wrap(std::move(converted), double(options.buffer) / options.extent,
+                                     options.lineMetrics);
+        wrapping.done(features);
+
+        std::vector<uint64_t> changed;
+        std::vector<uint64_t> stale;
+
+        std::unique_lock<detail::sharded_mutex> lock(mutex);
+        drilled.wait(lock, [&] { return drilling.empty(); });
+
+        patch(std::move(features), 0, 0, 0, ids, changed, stale);
+
+        for (const uint64_t id : stale) {
+            cached.erase(id);
+            removed(id);
+        }
+
+        changed.insert(changed.end(), stale.begin(), stale.end());
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        return changed;
+    }
+
+    // remove the features with the given ids from tile z/x/y and the tiles under it, and add the
+    // given features clipped to the tile; tiles under a missing tile were drilled down to from a
+    // tile above that keeps its geometry, so they are dropped to be made again from that one
+    void patch(detail::vt_features features,
+               const uint8_t z,
+               const uint32_t x,
+               const uint32_t y,
+               const std::vector<mapbox::feature::identifier>& ids,
+               std::vector<uint64_t>& changed,
+               std::vector<uint64_t>& stale) {
+        const uint64_t id = toID(z, x, y);
+        auto it = findTile(id);
+
+        if (it == tiles.end()) {
+            tiles.eachDescendant(z, x, y, [&](const auto& pair) { stale.push_back(pair.first); });
+            snapshot.takeAll(z, x, y, [&](const uint8_t tz, const uint32_t tx, const uint32_t ty) {
+                changed.push_back(toID(tz, tx, ty));
+            });
+            empties.erase(z, x, y);
+            solids.erase(z, x, y);
+            return;
+        }
+
+        auto& tile = it->second;
+
+        // a covered tile gets back the squares it dropped, to be sliced like any other tile
+        if (const auto solid = solids.find(z, x, y)) {
+            const auto listed = [&](const mapbox::feature::feature<int16_t>& feature) {
+                return std::binary_search(ids.begin(), ids.end(), feature.id);
+            };
+            const auto& squares = (*solid)->features;
+            if (features.empty() && std::none_of(squares.begin(), squares.end(), listed))
+                return;
+            tile.source_features = coveringFeatures(**solid, z, x, y);
+            tile.num_points = 0;
+            for (const auto& feature : tile.source_features) {
+                tile.num_points += feature.num_points;
+            }
+            solids.erase(z, x, y);
+        }
+
+        const bool found = !ids.empty() && tile.remove(ids);
+        if (!found && features.empty())
+            return;
+
+        tile.add(features);
+        changed.push_back(id);
+        empties.erase(z, x, y);
+
+        if (z == options.maxZoom)
+            return;
+
+        std::array<detail::vt_features, 4> children;
+        if (!features.empty())
+            children = quadrants(features, z, x, y);
+        features = {};
+
+        for (uint8_t i = 0; i < 4; ++i) {
+            if (found || !children[i].empty())
+                patch(std::move(children[i]), z + 1, x * 2 + i / 2, y * 2 + i % 2, ids, changed,
+                      stale);
+        }
+    }
+
+    // the features of tile z/x/y, which is covered by the polygons of the given shared tile
+    detail::vt_features
+    coveringFeatures(const Tile& solid, const uint8_t z, const uint32_t x, const uint32_t y) const {
+        const double z2 = 1u << z;
+        const double p = double(options.buffer) / options.extent;
+        const double x1 = (x - p) / z2;
+        const double y1 = (y - p) / z2;
+        const double x2 = (x + 1 + p) / z2;
+        const double y2 = (y + 1 + p) / z2;
+
+        detail::vt_features features;
+        for (const auto& feature : solid.features) {
+            const auto& square = feature.geometry.get<mapbox::geometry::polygon<int16_t>>()[0];
+            detail::vt_linear_ring ring;
+            for (const auto& point : square) {
+                ring.push_back({ point.x < 0 ? x1 : x2, point.y < 0 ? y1 : y2, 1.0 });
+            }
+            ring.area = (x2 - x1) * (y2 - y1);
+            features.emplace_back(detail::vt_polygon{ std::move(ring) },
+                                  detail::makeShared<mapbox::feature::property_map>(
+                                      feature.properties),
+                                  feature.id);
+        }
+        return features;
+    }
+
+    detail::tile_map<detail::InternalTile>::iterator
     findParent(const uint8_t z, const uint32_t x, const uint32_t y) {
         uint8_t z0 = z;
         uint32_t x0 = x;
@@ -169,19 +1252,26 @@ private:
             z0--;
             x0 = x0 / 2;
             y0 = y0 / 2;
-            parent = tiles.find(toID(z0, x0, y0));
+            parent = findTile(toID(z0, x0, y0));
+
+            // a tile that was sliced further has no geometry left to drill down from; we only get
+            // here when the child on the way down was evicted, so keep looking further up, unless
+            // it is being sliced right now
+            if (parent != end && parent->second.source_features.empty() &&
+                parent->second.num_points != 0 && !isDrilling(parent->first))
+                parent = end;
         }
 
         return parent;
     }
 
-    void splitTile(const detail::vt_features& features,
+    // targets are the sorted Z-order keys of the tiles to drill down to, none in first-pass tiling
+    void splitTile(detail::vt_features features,
                    const uint8_t z,
                    const uint32_t x,
                    const uint32_t y,
-                   const uint8_t cz = 0,
-                   const uint32_t cx = 0,
-                   const uint32_t cy = 0) {
+                   const std::vector<uint64_t>& targets = {},
+                   const uint32_t threads = 1) {
 
         const double z2 = 1u << z;
         const uint64_t id = toID(z, x, y);
@@ -196,65 +1286,218 @@ private:
                      .emplace(id,
                               detail::InternalTile{ features, z, x, y, options.extent, tolerance, options.lineMetrics })
                      .first;
-            stats[z] = (stats.count(z) ? stats[z] + 1 : 1);
-            total++;
+            observe(it->second);
+            added(id, z);
             // printf("tile z%i-%i-%i\n", z, x, y);
         }
 
         auto& tile = it->second;
 
-        if (features.empty())
+        if (features.empty()) {
+            charge(*it);
             return;
+        }
 
-        // if it's the first-pass tiling
-        if (cz == 0u) {
-            // stop tiling if we reached max zoom, or if the tile is too simple
-            if (z == options.indexMaxZoom || tile.tile.num_points <= options.indexMaxPoints) {
-                tile.source_features = features;
+        // a tile covered by polygons needs no slicing, the tiles under it are all the same square
+        if (z < options.maxZoom) {
+            auto solid = detail::coveredTile(features, z, x, y, options.extent, options.buffer);
+            if (solid) {
+                solids.insert(z, x, y, std::move(solid));
+                tile.materialize(features);
+                tile.source_features = {};
+                charge(*it);
                 return;
             }
+        }
 
-        } else { // drilldown to a specific tile;
-            // stop tiling if we reached base zoom
-            if (z == options.maxZoom)
+        // if it's the first-pass tiling
+        if (targets.empty()) {
+            // stop tiling if we reached max zoom, or if the tile is too simple, or if building the
+            // index used up one of its limits
+            if (z == options.indexMaxZoom || tile.num_points <= options.indexMaxPoints ||
+                (budget && !budget->split(uint64_t(tile.num_points) * sizeof(detail::vt_point)))) {
+                tile.source_features = std::move(features);
+                charge(*it);
                 return;
+            }
 
-            // stop tiling if it's our target tile zoom
-            if (z == cz) {
-                tile.source_features = features;
+        } else { // drilldown to specific tiles;
+            // stop tiling if we reached base zoom
+            if (z == options.maxZoom) {
+                tile.materialize(features);
                 return;
             }
 
-            // stop tiling if it's not an ancestor of the target tile
-            const double m = 1u << (cz - z);
-            if (x != static_cast<uint32_t>(std::floor(cx / m)) ||
-                y != static_cast<uint32_t>(std::floor(cy / m))) {
-                tile.source_features = features;
+            // stop tiling if it's not an ancestor of any target tile
+            if (!detail::anyBelow(targets, z, x, y)) {
+                tile.source_features = std::move(features);
                 return;
             }
         }
 
+        if (!targets.empty() && options.pathDrillDown) {
+            tile.source_features = std::move(features);
+            slicePath(tile.source_features, z, x, y, targets);
+            return;
+        }
+
+        // the tile can only be built from its own features, which slicing consumes
+        tile.materialize(features);
+        charge(*it);
+        sliceTile(std::move(features), z, x, y, targets, threads);
+
+        // if we sliced further down, no need to keep source geometry
+        if (targets.empty() || !keepsSource(z))
+            tile.source_features = {};
+    }
+
+    // the features of tile z/x/y clipped to each of its children, with their buffers
+    std::array<detail::vt_features, 4> quadrants(const detail::vt_features& features,
+                                                 const uint8_t z,
+                                                 const uint32_t x,
+                                                 const uint32_t y) const {
+        const double z2 = 1u << z;
         const double p = 0.5 * options.buffer / options.extent;
-        const auto& min = tile.bbox.min;
-        const auto& max = tile.bbox.max;
 
-        const auto left = detail::clip<0>(features, (x - p) / z2, (x + 0.5 + p) / z2, min.x, max.x, options.lineMetrics);
+        const detail::stage_timer splitting(observer(), Stage::split, z, x, y);
+        auto children =
+            detail::clipQuadrants(features, (x - p) / z2, (x + 0.5 + p) / z2, (x + 0.5 - p) / z2,
+                                  (x + 1 + p) / z2, (y - p) / z2, (y + 0.5 + p) / z2,
+                                  (y + 0.5 - p) / z2, (y + 1 + p) / z2, options.lineMetrics);
+        splitting.done(children);
+        return children;
+    }
+
+    // the features of tile z/x/y clipped to its child i (numbered like the quadrants above)
+    detail::vt_features quadrant(const detail::vt_features& features,
+                                 const uint8_t z,
+                                 const uint32_t x,
+                                 const uint32_t y,
+                                 const uint8_t i) const {
+        const double z2 = 1u << z;
+        const double p = 0.5 * options.buffer / options.extent;
+        const double x0 = x + 0.5 * (i / 2);
+        const double y0 = y + 0.5 * (i % 2);
+        const uint8_t cz = z + 1;
+        const uint32_t cx = x * 2 + i / 2;
+        const uint32_t cy = y * 2 + i % 2;
 
-        splitTile(detail::clip<1>(left, (y - p) / z2, (y + 0.5 + p) / z2, min.y, max.y, options.lineMetrics), z + 1,
-                  x * 2, y * 2, cz, cx, cy);
-        splitTile(detail::clip<1>(left, (y + 0.5 - p) / z2, (y + 1 + p) / z2, min.y, max.y, options.lineMetrics), z + 1,
-                  x * 2, y * 2 + 1, cz, cx, cy);
+        const detail::stage_timer columns(observer(), Stage::clipX, cz, cx, cy);
+        auto column = detail::clip<0>(features, (x0 - p) / z2, (x0 + 0.5 + p) / z2, -1, 2,
+                                      options.lineMetrics);
+        columns.done(column);
 
-        const auto right =
-            detail::clip<0>(features, (x + 0.5 - p) / z2, (x + 1 + p) / z2, min.x, max.x, options.lineMetrics);
+        const detail::stage_timer rows(observer(), Stage::clipY, cz, cx, cy);
+        auto clipped = detail::clip<1>(std::move(column), (y0 - p) / z2, (y0 + 0.5 + p) / z2, -1,
+                                       2, options.lineMetrics);
+        rows.done(clipped);
+        return clipped;
+    }
 
-        splitTile(detail::clip<1>(right, (y - p) / z2, (y + 0.5 + p) / z2, min.y, max.y, options.lineMetrics), z + 1,
-                  x * 2 + 1, y * 2, cz, cx, cy);
-        splitTile(detail::clip<1>(right, (y + 0.5 - p) / z2, (y + 1 + p) / z2, min.y, max.y, options.lineMetrics), z + 1,
-                  x * 2 + 1, y * 2 + 1, cz, cx, cy);
+    // clip the features of a tile straight to each of the tiles with the given ids under it; tiles
+    // under another one of them are drilled down to from that one instead
+    void clipTiles(const detail::vt_features& features,
+                   const std::vector<uint64_t>& ids,
+                   const std::vector<uint64_t>& targets) {
+        const double p = double(options.buffer) / options.extent;
 
-        // if we sliced further down, no need to keep source geometry
-        tile.source_features = {};
+        for (const uint64_t id : ids) {
+            uint8_t z;
+            uint32_t x;
+            uint32_t y;
+            std::tie(z, x, y) = detail::fromID(id);
+
+            const auto above = [&](const uint64_t other) {
+                uint8_t oz;
+                uint32_t ox;
+                uint32_t oy;
+                std::tie(oz, ox, oy) = detail::fromID(other);
+                return oz < z && (x >> (z - oz)) == ox && (y >> (z - oz)) == oy;
+            };
+            if (tiles.count(id) != 0 || std::any_of(ids.begin(), ids.end(), above))
+                continue;
+
+            const double z2 = 1u << z;
+            const detail::stage_timer columns(observer(), Stage::clipX, z, x, y);
+            auto column = detail::clip<0>(features, (x - p) / z2, (x + 1 + p) / z2, -1, 2,
+                                          options.lineMetrics);
+            columns.done(column);
+
+            const detail::stage_timer rows(observer(), Stage::clipY, z, x, y);
+            auto clipped = detail::clip<1>(std::move(column), (y - p) / z2, (y + 1 + p) / z2, -1, 2,
+                                           options.lineMetrics);
+            rows.done(clipped);
+            splitTile(std::move(clipped), z, x, y, targets);
+        }
+    }
+
+    // drill down from tile z/x/y only into the children that have target tiles in them
+    void slicePath(const detail::vt_features& features,
+                   const uint8_t z,
+                   const uint32_t x,
+                   const uint32_t y,
+                   const std::vector<uint64_t>& targets) {
+        for (uint8_t i = 0; i < 4; ++i) {
+            const uint32_t cx = x * 2 + i / 2;
+            const uint32_t cy = y * 2 + i % 2;
+            if (detail::anyWithin(targets, z + 1, cx, cy))
+                splitTile(quadrant(features, z, x, y, i), z + 1, cx, cy, targets);
+        }
+    }
+
+    // split the features of tile z/x/y into its four children
+    void sliceTile(detail::vt_features features,
+                   const uint8_t z,
+                   const uint32_t x,
+                   const uint32_t y,
+                   const std::vector<uint64_t>& targets,
+                   const uint32_t threads = 1) {
+
+        if (!targets.empty() && options.pathDrillDown) {
+            slicePath(features, z, x, y, targets);
+            return;
+        }
+
+        auto children = quadrants(features, z, x, y);
+        features = {};
+
+        if (threads > 1) {
+            // quadrants are independent, so they are shared between up to four workers, this
+            // thread being the first, and the threads between the workers; the other workers each
+            // build their quadrants into a separate index, merged when done, so that no more than
+            // threads threads run at once below this tile
+            const uint32_t workers = std::min<uint32_t>(threads, 4);
+            const auto share = [&](const uint32_t w) {
+                return threads / workers + (w < threads % workers ? 1 : 0);
+            };
+            std::vector<std::future<GeoJSONVT>> subtrees;
+
+            for (uint32_t w = 1; w < workers; ++w) {
+                subtrees.push_back(std::async(std::launch::async, [&, w] {
+                    GeoJSONVT subtree{ options };
+                    subtree.budget = budget;
+                    for (uint32_t i = w; i < 4; i += workers) {
+                        subtree.splitTile(std::move(children[i]), z + 1, x * 2 + i / 2,
+                                          y * 2 + i % 2, targets, share(w));
+                    }
+                    return subtree;
+                }));
+            }
+
+            for (uint32_t i = 0; i < 4; i += workers) {
+                splitTile(std::move(children[i]), z + 1, x * 2 + i / 2, y * 2 + i % 2, targets,
+                          share(0));
+            }
+
+            for (auto& subtree : subtrees) {
+                merge(subtree.get());
+            }
+
+        } else {
+            for (uint8_t i = 0; i < 4; ++i) {
+                splitTile(std::move(children[i]), z + 1, x * 2 + i / 2, y * 2 + i % 2, targets);
+            }
+        }
     }
 };
 
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+/* A pool of fixed-size blocks for the short-lived vectors created while clipping. Every thread
+ * keeps its own free lists, so allocating and freeing a block mostly takes no lock; blocks are
+ * carved out of large shared slabs that are kept for reuse rather than returned to the system.
+ * Free blocks move between threads in batches through the shared pool: a thread whose list is
+ * empty takes a batch from it, if the pool has any, before carving from its slab, one whose list
+ * grows long gives a batch back, and an exiting thread hands over all of its blocks and the rest of its slab, so that the
+ * slabs stay bounded by the blocks in use at once, however many threads come and go. Requests
+ * larger than the biggest size class go straight to operator new.
+ */
+
+class block_pool {
+public:
+    static constexpr std::size_t min_block = 16;
+    static constexpr std::size_t classes = 13; // 16 bytes to 64 KiB
+    static constexpr std::size_t max_block = min_block << (classes - 1);
+    static constexpr std::size_t slab_size = 1 << 20;
+    static constexpr std::size_t batch = 32; // blocks moved to or from the shared pool at once
+
+    static void* allocate(const std::size_t size) {
+        if (size > max_block)
+            return ::operator new(size);
+
+        const std::size_t c = sizeClass(size);
+        auto& cache = local();
+        if (cache.retired)
+            return global().allocate(c);
+
+        // the pool is only locked when it has blocks to give, which it rarely does while memory
+        // use is growing
+        if (!cache.free[c] && global().available(c))
+            cache.count[c] = global().refill(cache.free[c], c);
+
+        block* head = cache.free[c];
+        if (head) {
+            cache.free[c] = head->next;
+            cache.count[c]--;
+            return head;
+        }
+
+        const std::size_t blockSize = min_block << c;
+        if (cache.cursor + blockSize > cache.end) {
+            cache.cursor = global().newSlab();
+            cache.end = cache.cursor + slab_size;
+        }
+        void* result = cache.cursor;
+        cache.cursor += blockSize;
+        return result;
+    }
+
+    static void deallocate(void* p, const std::size_t size) {
+        if (size > max_block) {
+            ::operator delete(p);
+            return;
+        }
+
+        const std::size_t c = sizeClass(size);
+        auto& cache = local();
+        if (cache.retired) {
+            global().deallocate(static_cast<block*>(p), c);
+            return;
+        }
+
+        block* b = static_cast<block*>(p);
+        b->next = cache.free[c];
+        cache.free[c] = b;
+
+        // blocks allocated on other threads and freed on this one would otherwise pile up here
+        if (++cache.count[c] == 2 * batch) {
+            block* last = b;
+            for (std::size_t i = 1; i < batch; ++i) {
+                last = last->next;
+            }
+            cache.free[c] = last->next;
+            cache.count[c] -= batch;
+            last->next = nullptr;
+            global().give(b, last, batch, c);
+        }
+    }
+
+private:
+    struct block {
+        block* next;
+    };
+
+    struct thread_cache {
+        block* free[classes];
+        std::size_t count[classes];
+        char* cursor;
+        char* end;
+        bool retired;
+    };
+
+    // hands the free blocks of a thread back to the shared pool when the thread exits
+    struct thread_guard {
+        thread_cache& cache;
+
+        ~thread_guard() {
+            global().release(cache);
+            cache.retired = true;
+        }
+    };
+
+    struct shared_pool {
+        std::mutex mutex;
+        block* free[classes] = {};
+        std::atomic<std::size_t> counts[classes] = {}; // blocks in free, readable without mutex
+        char* cursor = nullptr;
+        char* end = nullptr;
+        std::vector<std::unique_ptr<char[]>> slabs;
+
+        char* newSlab() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return newSlabLocked();
+        }
+
+        // whether there may be free blocks of class c, without locking
+        bool available(const std::size_t c) const {
+            return counts[c].load(std::memory_order_relaxed) != 0;
+        }
+
+        // used by threads that have already released their cache
+        void* allocate(const std::size_t c) {
+            std::lock_guard<std::mutex> lock(mutex);
+            block* head = free[c];
+            if (head) {
+                free[c] = head->next;
+                counts[c].fetch_sub(1, std::memory_order_relaxed);
+                return head;
+            }
+            const std::size_t blockSize = min_block << c;
+            if (cursor + blockSize > end) {
+                cursor = newSlabLocked();
+                end = cursor + slab_size;
+            }
+            void* result = cursor;
+            cursor += blockSize;
+            return result;
+        }
+
+        void deallocate(block* b, const std::size_t c) {
+            std::lock_guard<std::mutex> lock(mutex);
+            b->next = free[c];
+            free[c] = b;
+            counts[c].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // moves up to a batch of free blocks to the given empty list; returns how many
+        std::size_t refill(block*& list, const std::size_t c) {
+            std::lock_guard<std::mutex> lock(mutex);
+            block* head = free[c];
+            if (!head)
+                return 0;
+            block* last = head;
+            std::size_t n = 1;
+            for (; n < batch && last->next; ++n) {
+                last = last->next;
+            }
+            free[c] = last->next;
+            last->next = nullptr;
+            list = head;
+            counts[c].fetch_sub(n, std::memory_order_relaxed);
+            return n;
+        }
+
+        // takes the n blocks from first to last, linked in that order
+        void give(block* first, block* last, const std::size_t n, const std::size_t c) {
+            std::lock_guard<std::mutex> lock(mutex);
+            last->next = free[c];
+            free[c] = first;
+            counts[c].fetch_add(n, std::memory_order_relaxed);
+        }
+
+        void release(thread_cache& cache) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // the rest of the slab, cut into the largest blocks that fit; its start is a multiple
+            // of min_block into the slab, so every block stays aligned
+            for (std::size_t c = classes; c-- > 0;) {
+                const std::size_t blockSize = min_block << c;
+                while (cache.cursor && cache.cursor + blockSize <= cache.end) {
+                    block* b = reinterpret_cast<block*>(cache.cursor);
+                    cache.cursor += blockSize;
+                    b->next = free[c];
+                    free[c] = b;
+                    counts[c].fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            cache.cursor = cache.end = nullptr;
+
+            // freed blocks go on top, to be reused first
+            for (std::size_t c = 0; c < classes; ++c) {
+                block* head = cache.free[c];
+                if (!head)
+                    continue;
+                block* last = head;
+                std::size_t n = 1;
+                for (; last->next; ++n) {
+                    last = last->next;
+                }
+                last->next = free[c];
+                free[c] = head;
+                counts[c].fetch_add(n, std::memory_order_relaxed);
+                cache.free[c] = nullptr;
+                cache.count[c] = 0;
+            }
+        }
+
+    private:
+        char* newSlabLocked() {
+            slabs.emplace_back(new char[slab_size]);
+            return slabs.back().get();
+        }
+    };
+
+    static std::size_t sizeClass(const std::size_t size) {
+        std::size_t c = 0;
+        while ((min_block << c) < size)
+            ++c;
+        return c;
+    }
+
+    static thread_cache& local() {
+        // trivially destructible, so it stays usable after the guard has run at thread exit
+        static thread_local thread_cache cache{};
+        static thread_local thread_guard guard{ cache };
+        (void)guard;
+        return cache;
+    }
+
+    static shared_pool& global() {
+        // intentionally leaked: blocks may still be freed while static objects are destroyed
+        static shared_pool* pool = new shared_pool();
+        return *pool;
+    }
+};
+
+// a stateless allocator that draws from block_pool
+template <class T>
+class pool_allocator {
+public:
+    using value_type = T;
+
+    pool_allocator() noexcept = default;
+
+    template <class U>
+    pool_allocator(const pool_allocator<U>&) noexcept {
+    }
+
+    T* allocate(const std::size_t n) {
+        return static_cast<T*>(block_pool::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, const std::size_t n) noexcept {
+        block_pool::deallocate(p, n * sizeof(T));
+    }
+
+    template <class U>
+    bool operator==(const pool_allocator<U>&) const noexcept {
+        return true;
+    }
+
+    template <class U>
+    bool operator!=(const pool_allocator<U>&) const noexcept {
+        return false;
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
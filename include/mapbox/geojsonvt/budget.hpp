@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace mapbox {
+namespace geojsonvt {
+
+// the limit that stopped building an index early, as returned by GeoJSONVT::degraded
+enum class BuildLimit : uint8_t {
+    none,  // the index was built in full
+    tiles, // Options::maxIndexTiles
+    bytes, // Options::maxIndexBytes
+    time   // Options::maxIndexMilliseconds
+};
+
+namespace detail {
+
+/* What building an index may still use before it stops splitting tiles. It's shared by the
+ * threads building the index; once a limit is reached it stays reached, so that every thread
+ * stops at the tile it's at.
+ */
+class build_budget {
+public:
+    build_budget(const uint32_t maxTiles_, const uint64_t maxBytes_, const uint32_t maxMilliseconds)
+        : maxTiles(maxTiles_),
+          maxBytes(maxBytes_),
+          deadline(maxMilliseconds ? std::chrono::steady_clock::now() +
+                                         std::chrono::milliseconds(maxMilliseconds)
+                                   : std::chrono::steady_clock::time_point::max()) {
+    }
+
+    // bytes held by a tile that's done
+    void charge(const std::size_t n) {
+        bytes.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // whether a tile may be split into its four children, which need about the given number of
+    // bytes for their geometry; reserves the children if so
+    bool split(const uint64_t needed) {
+        if (reached() != BuildLimit::none)
+            return false;
+        if (std::chrono::steady_clock::now() >= deadline)
+            return stop(BuildLimit::time);
+        if (maxBytes && bytes.load(std::memory_order_relaxed) + needed > maxBytes)
+            return stop(BuildLimit::bytes);
+        if (maxTiles && tiles.fetch_add(4, std::memory_order_relaxed) + 4 > maxTiles) {
+            tiles.fetch_sub(4, std::memory_order_relaxed);
+            return stop(BuildLimit::tiles);
+        }
+        return true;
+    }
+
+    BuildLimit reached() const {
+        return static_cast<BuildLimit>(limit.load(std::memory_order_relaxed));
+    }
+
+private:
+    const uint32_t maxTiles;
+    const uint64_t maxBytes;
+    const std::chrono::steady_clock::time_point deadline;
+
+    std::atomic<uint64_t> tiles{ 1 }; // the top tile is there from the start
+    std::atomic<uint64_t> bytes{ 0 };
+    std::atomic<uint8_t> limit{ static_cast<uint8_t>(BuildLimit::none) };
+
+    // only the first limit reached is kept
+    bool stop(const BuildLimit reason) {
+        uint8_t none = static_cast<uint8_t>(BuildLimit::none);
+        limit.compare_exchange_strong(none, static_cast<uint8_t>(reason),
+                                      std::memory_order_relaxed);
+        return false;
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
@@ -2,10 +2,52 @@
 
 #include <mapbox/geojsonvt/types.hpp>
 
+#include <array>
+#include <utility>
+
 namespace mapbox {
 namespace geojsonvt {
 namespace detail {
 
+// stands in for a vt_line_string or vt_linear_ring slice when clipping flat geometry, appending
+// points straight to the flat result
+class flat_slice {
+public:
+    flat_slice(vt_flat_geometry& geom_, const double measure_)
+        : geom(geom_), start(geom_.points.size()), measure(measure_) {
+    }
+
+    double segStart = 0.0; // line metrics are not tracked for flat geometry
+    double segEnd = 0.0;
+
+    void push_back(const vt_point& p) {
+        geom.points.push_back(p);
+    }
+
+    bool empty() const {
+        return geom.points.size() == start;
+    }
+
+    const vt_point& front() const {
+        return geom.points[start];
+    }
+
+    const vt_point& back() const {
+        return geom.points.back();
+    }
+
+    // finish the current line or ring and start a new one
+    void cut() {
+        geom.endPart(start, measure);
+        start = geom.points.size();
+    }
+
+private:
+    vt_flat_geometry& geom;
+    size_t start;
+    const double measure;
+};
+
 template <uint8_t I>
 class clipper {
 public:
@@ -88,7 +130,75 @@ public:
         return result;
     }
 
+    vt_geometry operator()(const vt_flat_geometry& geom) const {
+        using shape = vt_flat_geometry::shape;
+        vt_flat_geometry result(geom.type);
+
+        if (geom.type == shape::point) {
+            for (const auto& p : geom.points) {
+                const double ak = get<I>(p);
+                if (ak >= k1 && ak <= k2)
+                    result.points.push_back(p);
+            }
+        } else if (geom.type == shape::line) {
+            for (size_t i = 0; i < geom.ends.size(); ++i) {
+                const size_t first = geom.partStart(i);
+                clipFlatLine(geom.points.data() + first, geom.ends[i] - first, geom.measures[i],
+                             result);
+            }
+        } else {
+            size_t ring = 0;
+            for (const auto polygonEnd : geom.polygons) {
+                const size_t start = result.ends.size();
+                for (; ring < polygonEnd; ++ring) {
+                    const size_t first = geom.partStart(ring);
+                    clipFlatRing(geom.points.data() + first, geom.ends[ring] - first,
+                                 geom.measures[ring], result);
+                }
+                result.endPolygon(start);
+            }
+        }
+        return result;
+    }
+
 private:
+    template <uint8_t>
+    friend class splitter;
+
+    void clipFlatLine(const vt_point* line,
+                      const size_t len,
+                      const double dist,
+                      vt_flat_geometry& result) const {
+        if (len < 2)
+            return;
+
+        flat_slice slice{ result, dist };
+        const auto cut = [&] { slice.cut(); };
+
+        for (size_t i = 0; i < (len - 1); ++i) {
+            clipLineSegment(line[i], line[i + 1], i == len - 2, 0.0, 0.0, slice, cut);
+        }
+
+        slice.cut();
+    }
+
+    void clipFlatRing(const vt_point* ring,
+                      const size_t len,
+                      const double area,
+                      vt_flat_geometry& result) const {
+        if (len < 2)
+            return;
+
+        flat_slice slice{ result, area };
+
+        for (size_t i = 0; i < (len - 1); ++i) {
+            clipRingSegment(ring[i], ring[i + 1], i == len - 2, slice);
+        }
+
+        endRing(slice);
+        slice.cut();
+    }
+
     vt_line_string newSlice(const vt_line_string& line) const {
         vt_line_string slice;
         slice.dist = line.dist;
@@ -103,88 +213,103 @@ private:
         const size_t len = line.size();
         double lineLen = line.segStart;
         double segLen = 0.0;
-        double t = 0.0;
 
         if (len < 2)
             return;
 
         vt_line_string slice = newSlice(line);
+        const auto cut = [&] {
+            slices.push_back(std::move(slice));
+            slice = newSlice(line);
+        };
 
         for (size_t i = 0; i < (len - 1); ++i) {
             const auto& a = line[i];
             const auto& b = line[i + 1];
-            const double ak = get<I>(a);
-            const double bk = get<I>(b);
 
             if (lineMetrics) segLen = ::hypot((b.x - a.x), (b.y - a.y));
 
-            if (ak < k1) {
-                if (bk > k2) { // ---|-----|-->
-                    t = calc_progress<I>(a, b, k1);
-                    slice.push_back(intersect<I>(a, b, k1, t));
-                    if (lineMetrics) slice.segStart = lineLen + segLen * t;
+            clipLineSegment(a, b, i == len - 2, lineLen, segLen, slice, cut);
 
-                    t = calc_progress<I>(a, b, k2);
-                    slice.push_back(intersect<I>(a, b, k2, t));
-                    if (lineMetrics) slice.segEnd = lineLen + segLen * t;
-                    slices.push_back(std::move(slice));
+            if (lineMetrics) lineLen += segLen;
+        }
 
-                    slice = newSlice(line);
+        endLine(lineLen, slice, slices);
+    }
 
-                } else if (bk > k1) { // ---|-->  |
-                    t = calc_progress<I>(a, b, k1);
-                    slice.push_back(intersect<I>(a, b, k1, t));
-                    if (lineMetrics) slice.segStart = lineLen + segLen * t;
+    // cut() finishes the current slice and starts a new one
+    template <class Slice, class Cut>
+    void clipLineSegment(const vt_point& a,
+                         const vt_point& b,
+                         const bool last,
+                         const double lineLen,
+                         const double segLen,
+                         Slice& slice,
+                         Cut&& cut) const {
+        const double ak = get<I>(a);
+        const double bk = get<I>(b);
+        double t = 0.0;
 
-                    if (i == len - 2)
-                        slice.push_back(b); // last point
-                }
-            } else if (ak > k2) {
-                if (bk < k1) { // <--|-----|---
-                    t = calc_progress<I>(a, b, k2);
-                    slice.push_back(intersect<I>(a, b, k2, t));
-                    if (lineMetrics) slice.segStart = lineLen + segLen * t;
-
-                    t = calc_progress<I>(a, b, k1);
-                    slice.push_back(intersect<I>(a, b, k1, t));
-                    if (lineMetrics) slice.segEnd = lineLen + segLen * t;
-
-                    slices.push_back(std::move(slice));
-
-                    slice = newSlice(line);
-                } else if (bk < k2) { // |  <--|---
-                    t = calc_progress<I>(a, b, k2);
-                    slice.push_back(intersect<I>(a, b, k2, t));
-                    if (lineMetrics) slice.segStart = lineLen + segLen * t;
-
-                    if (i == len - 2)
-                        slice.push_back(b); // last point
-                }
-            } else {
-                slice.push_back(a);
-
-                if (bk < k1) { // <--|---  |
-                    t = calc_progress<I>(a, b, k1);
-                    slice.push_back(intersect<I>(a, b, k1, t));
-                    if (lineMetrics) slice.segEnd = lineLen + segLen * t;
-                    slices.push_back(std::move(slice));
-                    slice = newSlice(line);
-
-                } else if (bk > k2) { // |  ---|-->
-                    t = calc_progress<I>(a, b, k2);
-                    slice.push_back(intersect<I>(a, b, k2, t));
-                    if (lineMetrics) slice.segEnd = lineLen + segLen * t;
-                    slices.push_back(std::move(slice));
-                    slice = newSlice(line);
-
-                } else if (i == len - 2) { // | --> |
-                    slice.push_back(b);
-                }
-            }
+        if (ak < k1) {
+            if (bk > k2) { // ---|-----|-->
+                t = calc_progress<I>(a, b, k1);
+                slice.push_back(intersect<I>(a, b, k1, t));
+                if (lineMetrics) slice.segStart = lineLen + segLen * t;
 
-            if (lineMetrics) lineLen += segLen;
+                t = calc_progress<I>(a, b, k2);
+                slice.push_back(intersect<I>(a, b, k2, t));
+                if (lineMetrics) slice.segEnd = lineLen + segLen * t;
+                cut();
+
+            } else if (bk > k1) { // ---|-->  |
+                t = calc_progress<I>(a, b, k1);
+                slice.push_back(intersect<I>(a, b, k1, t));
+                if (lineMetrics) slice.segStart = lineLen + segLen * t;
+
+                if (last)
+                    slice.push_back(b); // last point
+            }
+        } else if (ak > k2) {
+            if (bk < k1) { // <--|-----|---
+                t = calc_progress<I>(a, b, k2);
+                slice.push_back(intersect<I>(a, b, k2, t));
+                if (lineMetrics) slice.segStart = lineLen + segLen * t;
+
+                t = calc_progress<I>(a, b, k1);
+                slice.push_back(intersect<I>(a, b, k1, t));
+                if (lineMetrics) slice.segEnd = lineLen + segLen * t;
+                cut();
+
+            } else if (bk < k2) { // |  <--|---
+                t = calc_progress<I>(a, b, k2);
+                slice.push_back(intersect<I>(a, b, k2, t));
+                if (lineMetrics) slice.segStart = lineLen + segLen * t;
+
+                if (last)
+                    slice.push_back(b); // last point
+            }
+        } else {
+            slice.push_back(a);
+
+            if (bk < k1) { // <--|---  |
+                t = calc_progress<I>(a, b, k1);
+                slice.push_back(intersect<I>(a, b, k1, t));
+                if (lineMetrics) slice.segEnd = lineLen + segLen * t;
+                cut();
+
+            } else if (bk > k2) { // |  ---|-->
+                t = calc_progress<I>(a, b, k2);
+                slice.push_back(intersect<I>(a, b, k2, t));
+                if (lineMetrics) slice.segEnd = lineLen + segLen * t;
+                cut();
+
+            } else if (last) { // | --> |
+                slice.push_back(b);
+            }
         }
+    }
 
+    void endLine(const double lineLen, vt_line_string& slice, vt_multi_line_string& slices) const {
         if (!slice.empty()) { // add the final slice
             slice.segEnd = lineLen;
             slices.push_back(std::move(slice));
@@ -200,41 +325,54 @@ private:
             return slice;
 
         for (size_t i = 0; i < (len - 1); ++i) {
-            const auto& a = ring[i];
-            const auto& b = ring[i + 1];
-            const double ak = get<I>(a);
-            const double bk = get<I>(b);
-
-            if (ak < k1) {
-                if (bk > k1) {
-                    // ---|-->  |
-                    slice.push_back(intersect<I>(a, b, k1, calc_progress<I>(a, b, k1)));
-                    if (bk > k2)
-                        // ---|-----|-->
-                        slice.push_back(intersect<I>(a, b, k2, calc_progress<I>(a, b, k2)));
-                    else if (i == len - 2)
-                        slice.push_back(b); // last point
-                }
-            } else if (ak > k2) {
-                if (bk < k2) { // |  <--|---
+            clipRingSegment(ring[i], ring[i + 1], i == len - 2, slice);
+        }
+
+        endRing(slice);
+
+        return slice;
+    }
+
+    template <class Slice>
+    void clipRingSegment(const vt_point& a,
+                         const vt_point& b,
+                         const bool last,
+                         Slice& slice) const {
+        const double ak = get<I>(a);
+        const double bk = get<I>(b);
+
+        if (ak < k1) {
+            if (bk > k1) {
+                // ---|-->  |
+                slice.push_back(intersect<I>(a, b, k1, calc_progress<I>(a, b, k1)));
+                if (bk > k2)
+                    // ---|-----|-->
                     slice.push_back(intersect<I>(a, b, k2, calc_progress<I>(a, b, k2)));
-                    if (bk < k1) // <--|-----|---
-                        slice.push_back(intersect<I>(a, b, k1, calc_progress<I>(a, b, k1)));
-                    else if (i == len - 2)
-                        slice.push_back(b); // last point
-                }
-            } else {
-                // | --> |
-                slice.push_back(a);
-                if (bk < k1)
-                    // <--|---  |
+                else if (last)
+                    slice.push_back(b); // last point
+            }
+        } else if (ak > k2) {
+            if (bk < k2) { // |  <--|---
+                slice.push_back(intersect<I>(a, b, k2, calc_progress<I>(a, b, k2)));
+                if (bk < k1) // <--|-----|---
                     slice.push_back(intersect<I>(a, b, k1, calc_progress<I>(a, b, k1)));
-                else if (bk > k2)
-                    // |  ---|-->
-                    slice.push_back(intersect<I>(a, b, k2, calc_progress<I>(a, b, k2)));
+                else if (last)
+                    slice.push_back(b); // last point
             }
+        } else {
+            // | --> |
+            slice.push_back(a);
+            if (bk < k1)
+                // <--|---  |
+                slice.push_back(intersect<I>(a, b, k1, calc_progress<I>(a, b, k1)));
+            else if (bk > k2)
+                // |  ---|-->
+                slice.push_back(intersect<I>(a, b, k2, calc_progress<I>(a, b, k2)));
         }
+    }
 
+    template <class Slice>
+    void endRing(Slice& slice) const {
         // close the polygon if its endpoints are not the same after clipping
         if (!slice.empty()) {
             const auto& first = slice.front();
@@ -243,8 +381,251 @@ private:
                 slice.push_back(first);
             }
         }
+    }
+};
 
-        return slice;
+/* clip geometry between two pairs of axis-parallel lines at once, walking every segment
+ * a single time and feeding it to both clippers; results match two separate clipper<I> passes
+ */
+
+template <uint8_t I>
+class splitter {
+public:
+    splitter(double k1, double k2, double k3, double k4, bool lineMetrics = false)
+        : low(k1, k2, lineMetrics), high(k3, k4, lineMetrics) {}
+
+    const clipper<I> low;
+    const clipper<I> high;
+
+    using result_type = std::pair<vt_geometry, vt_geometry>;
+
+    result_type operator()(const vt_empty& empty) const {
+        return { empty, empty };
+    }
+
+    result_type operator()(const vt_point& point) const {
+        return { point, point };
+    }
+
+    result_type operator()(const vt_multi_point& points) const {
+        vt_multi_point lowPart;
+        vt_multi_point highPart;
+        for (const auto& p : points) {
+            const double ak = get<I>(p);
+            if (ak >= low.k1 && ak <= low.k2)
+                lowPart.push_back(p);
+            if (ak >= high.k1 && ak <= high.k2)
+                highPart.push_back(p);
+        }
+        return { std::move(lowPart), std::move(highPart) };
+    }
+
+    result_type operator()(const vt_line_string& line) const {
+        vt_multi_line_string lowParts;
+        vt_multi_line_string highParts;
+        splitLine(line, lowParts, highParts);
+        return { toGeometry(std::move(lowParts)), toGeometry(std::move(highParts)) };
+    }
+
+    result_type operator()(const vt_multi_line_string& lines) const {
+        vt_multi_line_string lowParts;
+        vt_multi_line_string highParts;
+        for (const auto& line : lines) {
+            splitLine(line, lowParts, highParts);
+        }
+        return { toGeometry(std::move(lowParts)), toGeometry(std::move(highParts)) };
+    }
+
+    result_type operator()(const vt_polygon& polygon) const {
+        vt_polygon lowResult;
+        vt_polygon highResult;
+        splitPolygon(polygon, lowResult, highResult);
+        return { std::move(lowResult), std::move(highResult) };
+    }
+
+    result_type operator()(const vt_multi_polygon& polygons) const {
+        vt_multi_polygon lowResult;
+        vt_multi_polygon highResult;
+        for (const auto& polygon : polygons) {
+            vt_polygon lowPolygon;
+            vt_polygon highPolygon;
+            splitPolygon(polygon, lowPolygon, highPolygon);
+            if (!lowPolygon.empty())
+                lowResult.push_back(std::move(lowPolygon));
+            if (!highPolygon.empty())
+                highResult.push_back(std::move(highPolygon));
+        }
+        return { std::move(lowResult), std::move(highResult) };
+    }
+
+    result_type operator()(const vt_geometry_collection& geometries) const {
+        vt_geometry_collection lowResult;
+        vt_geometry_collection highResult;
+        for (const auto& geometry : geometries) {
+            auto parts = vt_geometry::visit(geometry, *this);
+            lowResult.push_back(std::move(parts.first));
+            highResult.push_back(std::move(parts.second));
+        }
+        return { std::move(lowResult), std::move(highResult) };
+    }
+
+    result_type operator()(const vt_flat_geometry& geom) const {
+        using shape = vt_flat_geometry::shape;
+        vt_flat_geometry lowResult(geom.type);
+        vt_flat_geometry highResult(geom.type);
+
+        if (geom.type == shape::point) {
+            for (const auto& p : geom.points) {
+                const double ak = get<I>(p);
+                if (ak >= low.k1 && ak <= low.k2)
+                    lowResult.points.push_back(p);
+                if (ak >= high.k1 && ak <= high.k2)
+                    highResult.points.push_back(p);
+            }
+        } else if (geom.type == shape::line) {
+            for (size_t i = 0; i < geom.ends.size(); ++i) {
+                const size_t first = geom.partStart(i);
+                splitFlatLine(geom.points.data() + first, geom.ends[i] - first, geom.measures[i],
+                              lowResult, highResult);
+            }
+        } else {
+            size_t ring = 0;
+            for (const auto polygonEnd : geom.polygons) {
+                const size_t lowStart = lowResult.ends.size();
+                const size_t highStart = highResult.ends.size();
+                for (; ring < polygonEnd; ++ring) {
+                    const size_t first = geom.partStart(ring);
+                    splitFlatRing(geom.points.data() + first, geom.ends[ring] - first,
+                                  geom.measures[ring], lowResult, highResult);
+                }
+                lowResult.endPolygon(lowStart);
+                highResult.endPolygon(highStart);
+            }
+        }
+        return { std::move(lowResult), std::move(highResult) };
+    }
+
+private:
+    static vt_geometry toGeometry(vt_multi_line_string&& parts) {
+        if (parts.size() == 1)
+            return std::move(parts[0]);
+        else
+            return std::move(parts);
+    }
+
+    void splitLine(const vt_line_string& line,
+                   vt_multi_line_string& lowSlices,
+                   vt_multi_line_string& highSlices) const {
+        const size_t len = line.size();
+        const bool lineMetrics = low.lineMetrics;
+        double lineLen = line.segStart;
+        double segLen = 0.0;
+
+        if (len < 2)
+            return;
+
+        vt_line_string lowSlice = low.newSlice(line);
+        vt_line_string highSlice = high.newSlice(line);
+        const auto lowCut = [&] {
+            lowSlices.push_back(std::move(lowSlice));
+            lowSlice = low.newSlice(line);
+        };
+        const auto highCut = [&] {
+            highSlices.push_back(std::move(highSlice));
+            highSlice = high.newSlice(line);
+        };
+
+        for (size_t i = 0; i < (len - 1); ++i) {
+            const auto& a = line[i];
+            const auto& b = line[i + 1];
+            const bool last = i == len - 2;
+
+            if (lineMetrics) segLen = ::hypot((b.x - a.x), (b.y - a.y));
+
+            low.clipLineSegment(a, b, last, lineLen, segLen, lowSlice, lowCut);
+            high.clipLineSegment(a, b, last, lineLen, segLen, highSlice, highCut);
+
+            if (lineMetrics) lineLen += segLen;
+        }
+
+        low.endLine(lineLen, lowSlice, lowSlices);
+        high.endLine(lineLen, highSlice, highSlices);
+    }
+
+    void splitPolygon(const vt_polygon& polygon, vt_polygon& lowResult, vt_polygon& highResult) const {
+        for (const auto& ring : polygon) {
+            const size_t len = ring.size();
+            vt_linear_ring lowSlice;
+            vt_linear_ring highSlice;
+            lowSlice.area = ring.area;
+            highSlice.area = ring.area;
+
+            if (len < 2)
+                continue;
+
+            for (size_t i = 0; i < (len - 1); ++i) {
+                const auto& a = ring[i];
+                const auto& b = ring[i + 1];
+                const bool last = i == len - 2;
+
+                low.clipRingSegment(a, b, last, lowSlice);
+                high.clipRingSegment(a, b, last, highSlice);
+            }
+
+            low.endRing(lowSlice);
+            high.endRing(highSlice);
+
+            if (!lowSlice.empty())
+                lowResult.push_back(std::move(lowSlice));
+            if (!highSlice.empty())
+                highResult.push_back(std::move(highSlice));
+        }
+    }
+
+    void splitFlatLine(const vt_point* line,
+                       const size_t len,
+                       const double dist,
+                       vt_flat_geometry& lowResult,
+                       vt_flat_geometry& highResult) const {
+        if (len < 2)
+            return;
+
+        flat_slice lowSlice{ lowResult, dist };
+        flat_slice highSlice{ highResult, dist };
+        const auto lowCut = [&] { lowSlice.cut(); };
+        const auto highCut = [&] { highSlice.cut(); };
+
+        for (size_t i = 0; i < (len - 1); ++i) {
+            const bool last = i == len - 2;
+            low.clipLineSegment(line[i], line[i + 1], last, 0.0, 0.0, lowSlice, lowCut);
+            high.clipLineSegment(line[i], line[i + 1], last, 0.0, 0.0, highSlice, highCut);
+        }
+
+        lowSlice.cut();
+        highSlice.cut();
+    }
+
+    void splitFlatRing(const vt_point* ring,
+                       const size_t len,
+                       const double area,
+                       vt_flat_geometry& lowResult,
+                       vt_flat_geometry& highResult) const {
+        if (len < 2)
+            return;
+
+        flat_slice lowSlice{ lowResult, area };
+        flat_slice highSlice{ highResult, area };
+
+        for (size_t i = 0; i < (len - 1); ++i) {
+            const bool last = i == len - 2;
+            low.clipRingSegment(ring[i], ring[i + 1], last, lowSlice);
+            high.clipRingSegment(ring[i], ring[i + 1], last, highSlice);
+        }
+
+        low.endRing(lowSlice);
+        high.endRing(highSlice);
+        lowSlice.cut();
+        highSlice.cut();
     }
 };
 
@@ -255,6 +636,26 @@ private:
  *     |        |
  */
 
+template <uint8_t I>
+inline void clipFeature(const vt_feature& feature,
+                        const double k1,
+                        const double k2,
+                        const bool lineMetrics,
+                        vt_features& clipped) {
+    const auto& props = feature.properties;
+    const auto& id = feature.id;
+
+    vt_geometry clippedGeom = vt_geometry::visit(*feature.geometry, clipper<I>{ k1, k2, lineMetrics });
+
+    if (lineMetrics && clippedGeom.is<vt_multi_line_string>()) {
+        for (auto& segment : clippedGeom.get<vt_multi_line_string>()) {
+            clipped.emplace_back(std::move(segment), props, id);
+        }
+    } else {
+        clipped.emplace_back(std::move(clippedGeom), props, id);
+    }
+}
+
 template <uint8_t I>
 inline vt_features clip(const vt_features& features,
                         const double k1,
@@ -272,10 +673,6 @@ inline vt_features clip(const vt_features& features,
     vt_features clipped;
 
     for (const auto& feature : features) {
-        const auto& geom = feature.geometry;
-        const auto& props = feature.properties;
-        const auto& id = feature.id;
-
         const double min = get<I>(feature.bbox.min);
         const double max = get<I>(feature.bbox.max);
 
@@ -286,28 +683,143 @@ inline vt_features clip(const vt_features& features,
             continue;
 
         } else {
-            const auto& clippedGeom = vt_geometry::visit(geom, clipper<I>{ k1, k2, lineMetrics });
-
-            clippedGeom.match(
-                [&](const auto&) {
-                    clipped.emplace_back(clippedGeom, props, id);
-                },
-                [&](const vt_multi_line_string& result) {
-                    if (lineMetrics) {
-                        for (const auto& segment : result) {
-                            clipped.emplace_back(segment, props, id);
-                        }
-                    } else {
-                        clipped.emplace_back(clippedGeom, props, id);
-                    }
-                }
-            );
+            clipFeature<I>(feature, k1, k2, lineMetrics, clipped);
         }
     }
 
     return clipped;
 }
 
+// same as above, but moves features that don't need cutting instead of copying them
+template <uint8_t I>
+inline vt_features clip(vt_features&& features,
+                        const double k1,
+                        const double k2,
+                        const double minAll,
+                        const double maxAll,
+                        const bool lineMetrics) {
+
+    if (minAll >= k1 && maxAll < k2) // trivial accept
+        return std::move(features);
+
+    if (maxAll < k1 || minAll >= k2) // trivial reject
+        return {};
+
+    vt_features clipped;
+
+    for (auto& feature : features) {
+        const double min = get<I>(feature.bbox.min);
+        const double max = get<I>(feature.bbox.max);
+
+        if (min >= k1 && max < k2) { // trivial accept
+            clipped.push_back(std::move(feature));
+
+        } else if (max < k1 || min >= k2) { // trivial reject
+            continue;
+
+        } else {
+            clipFeature<I>(feature, k1, k2, lineMetrics, clipped);
+        }
+    }
+
+    return clipped;
+}
+
+// split a single geometry on axis I, calling accept(high) for trivially accepted sides and
+// emit(high, geometry) for every clipped part, the same way clip<I> would for each side
+template <uint8_t I, class Accept, class Emit>
+inline void splitGeometry(const vt_geometry& geom,
+                          const mapbox::geometry::box<double>& bbox,
+                          const splitter<I>& split,
+                          Accept&& accept,
+                          Emit&& emit) {
+    const double min = get<I>(bbox.min);
+    const double max = get<I>(bbox.max);
+    const auto& low = split.low;
+    const auto& high = split.high;
+
+    const bool lowAccept = min >= low.k1 && max < low.k2;
+    const bool lowClip = !lowAccept && !(max < low.k1 || min >= low.k2);
+    const bool highAccept = min >= high.k1 && max < high.k2;
+    const bool highClip = !highAccept && !(max < high.k1 || min >= high.k2);
+
+    const auto emitParts = [&](const bool isHigh, vt_geometry&& clippedGeom) {
+        if (low.lineMetrics && clippedGeom.is<vt_multi_line_string>()) {
+            for (auto& segment : clippedGeom.get<vt_multi_line_string>()) {
+                emit(isHigh, vt_geometry(std::move(segment)));
+            }
+        } else {
+            emit(isHigh, std::move(clippedGeom));
+        }
+    };
+
+    if (lowAccept)
+        accept(false);
+    if (highAccept)
+        accept(true);
+
+    if (lowClip && highClip) {
+        auto parts = vt_geometry::visit(geom, split);
+        emitParts(false, std::move(parts.first));
+        emitParts(true, std::move(parts.second));
+    } else if (lowClip) {
+        emitParts(false, vt_geometry::visit(geom, low));
+    } else if (highClip) {
+        emitParts(true, vt_geometry::visit(geom, high));
+    }
+}
+
+/* clip features into the four quadrants of a tile in a single pass, given the ranges covered by
+ * the left/right and top/bottom halves; quadrants are ordered top-left, bottom-left, top-right,
+ * bottom-right, and each one matches clip<1>(clip<0>(features, ...), ...)
+ *         x1    x3   x2    x4
+ *     y1 _|_____|____|_____|_
+ *         |  0  |    |  2  |
+ *     y3 _|_____|____|_____|_
+ *     y2 _|_____|____|_____|_
+ *         |  1  |    |  3  |
+ *     y4 _|_____|____|_____|_
+ */
+
+inline std::array<vt_features, 4> clipQuadrants(const vt_features& features,
+                                                const double x1,
+                                                const double x2,
+                                                const double x3,
+                                                const double x4,
+                                                const double y1,
+                                                const double y2,
+                                                const double y3,
+                                                const double y4,
+                                                const bool lineMetrics) {
+    const splitter<0> horizontal{ x1, x2, x3, x4, lineMetrics };
+    const splitter<1> vertical{ y1, y2, y3, y4, lineMetrics };
+
+    std::array<vt_features, 4> quadrants;
+
+    const auto splitVertical = [&](const bool right, const vt_feature& feature) {
+        auto& top = quadrants[right ? 2 : 0];
+        auto& bottom = quadrants[right ? 3 : 1];
+
+        splitGeometry<1>(
+            *feature.geometry, feature.bbox, vertical,
+            [&](const bool lower) { (lower ? bottom : top).push_back(feature); },
+            [&](const bool lower, vt_geometry&& part) {
+                (lower ? bottom : top).emplace_back(std::move(part), feature.properties, feature.id);
+            });
+    };
+
+    for (const auto& feature : features) {
+        splitGeometry<0>(
+            *feature.geometry, feature.bbox, horizontal,
+            [&](const bool right) { splitVertical(right, feature); },
+            [&](const bool right, vt_geometry&& part) {
+                splitVertical(right, vt_feature{ std::move(part), feature.properties, feature.id });
+            });
+    }
+
+    return quadrants;
+}
+
 } // namespace detail
 } // namespace geojsonvt
 } // namespace mapbox
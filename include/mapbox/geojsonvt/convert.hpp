@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <memory>
 
 namespace mapbox {
 namespace geojsonvt {
@@ -98,8 +99,105 @@ struct project {
     }
 };
 
+// projects lines and polygons into vt_flat_geometry instead of the nested vt_* vectors; points
+// and geometry collections are projected as usual
+struct project_flat {
+    const double tolerance;
+    using result_type = vt_geometry;
+
+    vt_geometry operator()(const geometry::line_string<double>& line) {
+        vt_flat_geometry result(vt_flat_geometry::shape::line);
+        result.points.reserve(line.size());
+        addLine(line, result);
+        return result;
+    }
+
+    vt_geometry operator()(const geometry::multi_line_string<double>& lines) {
+        vt_flat_geometry result(vt_flat_geometry::shape::line);
+        for (const auto& line : lines) {
+            addLine(line, result);
+        }
+        return result;
+    }
+
+    vt_geometry operator()(const geometry::polygon<double>& polygon) {
+        vt_flat_geometry result(vt_flat_geometry::shape::polygon);
+        addPolygon(polygon, result);
+        return result;
+    }
+
+    vt_geometry operator()(const geometry::multi_polygon<double>& polygons) {
+        vt_flat_geometry result(vt_flat_geometry::shape::polygon);
+        for (const auto& polygon : polygons) {
+            addPolygon(polygon, result);
+        }
+        return result;
+    }
+
+    // empty, point, multi_point and geometry_collection
+    template <class T>
+    vt_geometry operator()(const T& geom) {
+        return project{ tolerance }(geom);
+    }
+
+private:
+    void addLine(const geometry::line_string<double>& line, vt_flat_geometry& result) {
+        const size_t len = line.size();
+        const size_t start = result.points.size();
+
+        if (len == 0)
+            return;
+
+        for (const auto& p : line) {
+            result.points.push_back(project{ tolerance }(p));
+        }
+
+        double dist = 0.0;
+
+        for (size_t i = start; i < start + len - 1; ++i) {
+            const auto& a = result.points[i];
+            const auto& b = result.points[i + 1];
+            dist += ::hypot((b.x - a.x), (b.y - a.y));
+        }
+
+        simplify(result.points.data() + start, len, tolerance);
+
+        result.endPart(start, dist);
+    }
+
+    void addPolygon(const geometry::polygon<double>& polygon, vt_flat_geometry& result) {
+        const size_t firstRing = result.ends.size();
+
+        for (const auto& ring : polygon) {
+            const size_t len = ring.size();
+            const size_t start = result.points.size();
+
+            if (len == 0)
+                continue;
+
+            for (const auto& p : ring) {
+                result.points.push_back(project{ tolerance }(p));
+            }
+
+            double area = 0.0;
+
+            for (size_t i = start; i < start + len - 1; ++i) {
+                const auto& a = result.points[i];
+                const auto& b = result.points[i + 1];
+                area += a.x * b.y - b.x * a.y;
+            }
+
+            simplify(result.points.data() + start, len, tolerance);
+
+            result.endPart(start, std::abs(area / 2));
+        }
+
+        result.endPolygon(firstRing);
+    }
+};
+
 inline vt_features convert(const feature::feature_collection<double>& features,
-                           const double tolerance, bool generateId) {
+                           const double tolerance, bool generateId, bool flat = false) {
     vt_features projected;
     projected.reserve(features.size());
     uint64_t genId = 0;
@@ -109,8 +207,9 @@ inline vt_features convert(const feature::feature_collection<double>& features,
             featureId = { uint64_t {genId++} };
         }
         projected.emplace_back(
-            geometry::geometry<double>::visit(feature.geometry, project{ tolerance }),
-            feature.properties, featureId);
+            flat ? geometry::geometry<double>::visit(feature.geometry, project_flat{ tolerance })
+                 : geometry::geometry<double>::visit(feature.geometry, project{ tolerance }),
+            makeShared<property_map>(feature.properties), featureId);
     }
     return projected;
 }
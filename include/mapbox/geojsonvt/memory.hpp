@@ -0,0 +1,266 @@
+#pragma once
+
+#include <mapbox/geojsonvt/tile.hpp>
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+
+// bytes of memory by what they hold; estimates from the sizes and capacities of the containers,
+// without the allocator's own overhead
+struct MemoryBytes {
+    std::size_t points = 0;     // coordinates of source geometry
+    std::size_t rings = 0;      // geometry objects, and the lines, rings and offsets they hold
+    std::size_t properties = 0; // property maps of source features
+    std::size_t features = 0;   // output tiles
+    std::size_t overhead = 0;   // tile objects, source feature records and the tile table
+
+    std::size_t total() const {
+        return points + rings + properties + features + overhead;
+    }
+
+    MemoryBytes& operator+=(const MemoryBytes& other) {
+        points += other.points;
+        rings += other.rings;
+        properties += other.properties;
+        features += other.features;
+        overhead += other.overhead;
+        return *this;
+    }
+};
+
+struct TileMemory {
+    uint8_t z = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    MemoryBytes bytes;
+};
+
+// memory held by an index, as returned by GeoJSONVT::memoryUsage
+struct MemoryUsage {
+    // everything, including the tile table and the tiles shared by covered subtrees, which
+    // belong to no zoom level
+    MemoryBytes total;
+
+    // the tiles at each zoom level
+    std::map<uint8_t, MemoryBytes> zooms;
+
+    // the tiles holding the most, heaviest first
+    std::vector<TileMemory> heaviest;
+};
+
+namespace detail {
+
+// bytes a string keeps on the heap; none when its characters are stored in the string object
+// itself (how many fit there depends on the standard library and its ABI), or when it is empty
+inline std::size_t heapBytes(const std::string& s) {
+    const char* data = s.data();
+    const char* self = reinterpret_cast<const char*>(&s);
+    // std::less orders any two pointers, where < between unrelated objects is unspecified
+    const std::less<const char*> before{};
+    if (s.capacity() == 0 || (!before(data, self) && before(data, self + sizeof(s))))
+        return 0;
+    return s.capacity() + 1;
+}
+
+inline std::size_t heapBytes(const property_map& map);
+
+inline std::size_t heapBytes(const mapbox::feature::value& value) {
+    if (value.is<std::string>())
+        return heapBytes(value.get<std::string>());
+    if (value.is<std::vector<mapbox::feature::value>>()) {
+        const auto& values = value.get<std::vector<mapbox::feature::value>>();
+        std::size_t bytes = values.capacity() * sizeof(mapbox::feature::value);
+        for (const auto& v : values) {
+            bytes += heapBytes(v);
+        }
+        return bytes;
+    }
+    if (value.is<property_map>())
+        return sizeof(property_map) + heapBytes(value.get<property_map>());
+    return 0;
+}
+
+// the buckets, and a node per entry holding the entry, a next pointer and the hash
+inline std::size_t heapBytes(const property_map& map) {
+    std::size_t bytes = map.bucket_count() * sizeof(void*);
+    for (const auto& pair : map) {
+        bytes += sizeof(pair) + 2 * sizeof(void*) + heapBytes(pair.first) + heapBytes(pair.second);
+    }
+    return bytes;
+}
+
+inline std::size_t heapBytes(const identifier& id) {
+    return id.is<std::string>() ? heapBytes(id.get<std::string>()) : 0;
+}
+
+struct geometry_bytes {
+    MemoryBytes& bytes;
+
+    template <class Points>
+    void points(const Points& p) const {
+        bytes.points += p.capacity() * sizeof(vt_point);
+    }
+
+    void operator()(const vt_empty&) const {
+    }
+
+    void operator()(const vt_point&) const {
+    }
+
+    void operator()(const vt_line_string& line) const {
+        points(line);
+    }
+
+    void operator()(const vt_multi_point& p) const {
+        points(p);
+    }
+
+    void operator()(const vt_polygon& polygon) const {
+        bytes.rings += polygon.capacity() * sizeof(vt_linear_ring);
+        for (const auto& ring : polygon) {
+            points(ring);
+        }
+    }
+
+    void operator()(const vt_multi_line_string& lines) const {
+        bytes.rings += lines.capacity() * sizeof(vt_line_string);
+        for (const auto& line : lines) {
+            points(line);
+        }
+    }
+
+    void operator()(const vt_multi_polygon& polygons) const {
+        bytes.rings += polygons.capacity() * sizeof(vt_polygon);
+        for (const auto& polygon : polygons) {
+            (*this)(polygon);
+        }
+    }
+
+    void operator()(const vt_geometry_collection& geometries) const {
+        bytes.rings += geometries.capacity() * sizeof(vt_geometry);
+        for (const auto& g : geometries) {
+            vt_geometry::visit(g, *this);
+        }
+    }
+
+    void operator()(const vt_flat_geometry& flat) const {
+        points(flat.points);
+        bytes.rings += flat.ends.capacity() * sizeof(uint32_t) +
+                       flat.measures.capacity() * sizeof(double) +
+                       flat.polygons.capacity() * sizeof(uint32_t);
+    }
+};
+
+// the geometry of output tiles, counted as a whole as output features
+struct tile_geometry_bytes {
+    std::size_t& bytes;
+
+    void points(const std::vector<mapbox::geometry::point<int16_t>>& p) const {
+        bytes += p.capacity() * sizeof(mapbox::geometry::point<int16_t>);
+    }
+
+    template <class Parts>
+    void parts(const Parts& p) const {
+        bytes += p.capacity() * sizeof(typename Parts::value_type);
+        for (const auto& part : p) {
+            (*this)(part);
+        }
+    }
+
+    void operator()(const mapbox::geometry::empty&) const {
+    }
+
+    void operator()(const mapbox::geometry::point<int16_t>&) const {
+    }
+
+    void operator()(const mapbox::geometry::line_string<int16_t>& line) const {
+        points(line);
+    }
+
+    void operator()(const mapbox::geometry::linear_ring<int16_t>& ring) const {
+        points(ring);
+    }
+
+    void operator()(const mapbox::geometry::multi_point<int16_t>& p) const {
+        points(p);
+    }
+
+    void operator()(const mapbox::geometry::polygon<int16_t>& polygon) const {
+        parts(polygon);
+    }
+
+    void operator()(const mapbox::geometry::multi_line_string<int16_t>& lines) const {
+        parts(lines);
+    }
+
+    void operator()(const mapbox::geometry::multi_polygon<int16_t>& polygons) const {
+        parts(polygons);
+    }
+
+    void operator()(const mapbox::geometry::geometry_collection<int16_t>& geometries) const {
+        bytes += geometries.capacity() * sizeof(mapbox::geometry::geometry<int16_t>);
+        for (const auto& g : geometries) {
+            mapbox::geometry::geometry<int16_t>::visit(g, *this);
+        }
+    }
+};
+
+// the bytes an output tile holds beyond the Tile object itself
+inline std::size_t heapBytes(const Tile& tile) {
+    std::size_t bytes =
+        tile.features.capacity() * sizeof(mapbox::feature::feature<int16_t>);
+    for (const auto& feature : tile.features) {
+        mapbox::geometry::geometry<int16_t>::visit(feature.geometry, tile_geometry_bytes{ bytes });
+        bytes += heapBytes(feature.properties) + heapBytes(feature.id);
+    }
+    return bytes;
+}
+
+/* Adds up the memory held by tiles. Geometry and property maps shared by several tiles count
+ * once, for the first tile measured that holds them; measuring tiles in Z-order charges them to
+ * the top tile they're in.
+ */
+class memory_counter {
+public:
+    template <class Value>
+    MemoryBytes measure(const Value& pair) {
+        const InternalTile& tile = pair.second;
+        MemoryBytes bytes;
+
+        bytes.overhead += sizeof(Value) + tile.source_features.capacity() * sizeof(vt_feature);
+        for (const auto& feature : tile.source_features) {
+            bytes.overhead += heapBytes(feature.id);
+
+            // objects made with makeShared live in one block with the reference counts
+            if (seen.insert(feature.geometry.get()).second) {
+                bytes.rings += sizeof(vt_geometry) + 2 * sizeof(long);
+                vt_geometry::visit(*feature.geometry, geometry_bytes{ bytes });
+            }
+            if (seen.insert(feature.properties.get()).second) {
+                bytes.properties +=
+                    sizeof(property_map) + 2 * sizeof(long) + heapBytes(*feature.properties);
+            }
+        }
+
+        if (const Tile* output = tile.builtTile()) {
+            bytes.features += heapBytes(*output) + tile.outputPoints().capacity() * sizeof(uint32_t);
+        }
+        return bytes;
+    }
+
+private:
+    std::unordered_set<const void*> seen;
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
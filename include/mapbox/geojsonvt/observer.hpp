@@ -0,0 +1,132 @@
+#pragma once
+
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// define GEOJSONVT_OBSERVE to report the time and output size of every stage of building an index
+// and drilling down to tiles to Options::observer; without it the hooks compile to nothing
+
+namespace mapbox {
+namespace geojsonvt {
+
+enum class Stage : uint8_t {
+    convert,   // projecting and simplifying the input features
+    wrap,      // copying features across the antimeridian
+    clipX,     // clipping features to a tile's columns
+    clipY,     // clipping features to a tile's rows
+    split,     // clipping features to the four children of a tile, both axes in one pass
+    transform, // turning a tile's features into tile coordinates
+    drillDown  // slicing a tile down to requested tiles under it
+};
+
+struct StageEvent {
+    Stage stage;
+
+    // the tile the stage worked on; 0/0/0 for convert and wrap, which work on the whole input
+    uint8_t z;
+    uint32_t x;
+    uint32_t y;
+
+    std::chrono::nanoseconds duration;
+
+    // features and points the stage produced; for drillDown, the tiles it made and no points
+    uint64_t features;
+    uint64_t points;
+
+    // for drillDown, the number of zoom levels between the tile and the deepest tile requested
+    uint8_t depth;
+};
+
+/* Receives an event at the end of every stage. Stages run on whichever thread builds the tiles,
+ * several at once when building on several threads, so observe must be safe to call
+ * concurrently; it runs while the index may be locked, so it must not call back into it.
+ */
+class Observer {
+public:
+    virtual ~Observer() = default;
+
+    virtual void observe(const StageEvent& event) = 0;
+};
+
+namespace detail {
+
+#ifdef GEOJSONVT_OBSERVE
+
+// times a stage from its construction until done is called, if there is an observer
+class stage_timer {
+public:
+    stage_timer(Observer* observer_,
+                const Stage stage_,
+                const uint8_t z_,
+                const uint32_t x_,
+                const uint32_t y_)
+        : observer(observer_), stage(stage_), z(z_), x(x_), y(y_) {
+        if (observer)
+            start = std::chrono::steady_clock::now();
+    }
+
+    void done(const uint64_t features, const uint64_t points, const uint8_t depth = 0) const {
+        if (!observer)
+            return;
+        const auto duration = std::chrono::steady_clock::now() - start;
+        observer->observe({ stage, z, x, y,
+                            std::chrono::duration_cast<std::chrono::nanoseconds>(duration),
+                            features, points, depth });
+    }
+
+    void done(const vt_features& features) const {
+        if (!observer)
+            return;
+        uint64_t points = 0;
+        for (const auto& feature : features) {
+            points += feature.num_points;
+        }
+        done(features.size(), points);
+    }
+
+    void done(const std::array<vt_features, 4>& quadrants) const {
+        if (!observer)
+            return;
+        uint64_t features = 0;
+        uint64_t points = 0;
+        for (const auto& quadrant : quadrants) {
+            features += quadrant.size();
+            for (const auto& feature : quadrant) {
+                points += feature.num_points;
+            }
+        }
+        done(features, points);
+    }
+
+private:
+    Observer* observer;
+    Stage stage;
+    uint8_t z;
+    uint32_t x;
+    uint32_t y;
+    std::chrono::steady_clock::time_point start;
+};
+
+#else
+
+class stage_timer {
+public:
+    stage_timer(Observer*, const Stage, const uint8_t, const uint32_t, const uint32_t) {
+    }
+
+    void done(const uint64_t, const uint64_t, const uint8_t = 0) const {
+    }
+
+    template <class Features>
+    void done(const Features&) const {
+    }
+};
+
+#endif
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <mapbox/geojsonvt/sync.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+
+/* Request latencies in buckets of eight per power of two nanoseconds, like an HDR histogram with
+ * one significant octal digit: a bucket is at most an eighth of its lower bound wide, so any
+ * percentile is within 12.5% of the exact one. The first eight buckets hold 0 to 7 ns exactly;
+ * latencies of more than an hour all go into the last bucket.
+ */
+struct LatencyHistogram {
+    static constexpr std::size_t buckets = 8 + 39 * 8;
+
+    // number of requests that took from lowerBound(i) up to lowerBound(i + 1) nanoseconds
+    std::vector<uint64_t> counts = std::vector<uint64_t>(buckets, 0);
+
+    static std::size_t bucket(const uint64_t nanoseconds) {
+        if (nanoseconds < 8)
+            return static_cast<std::size_t>(nanoseconds);
+        uint64_t v = nanoseconds;
+        uint8_t e = 0;
+        for (uint8_t s = 32; s > 0; s /= 2) {
+            if (v >> s) {
+                v >>= s;
+                e += s;
+            }
+        }
+        const std::size_t i = 8 + (e - 3) * 8 + ((nanoseconds >> (e - 3)) - 8);
+        return std::min(i, buckets - 1);
+    }
+
+    static uint64_t lowerBound(const std::size_t i) {
+        if (i < 8)
+            return i;
+        const std::size_t e = (i - 8) / 8 + 3;
+        return (8 + (i - 8) % 8) << (e - 3);
+    }
+
+    uint64_t count() const {
+        uint64_t n = 0;
+        for (const uint64_t c : counts) {
+            n += c;
+        }
+        return n;
+    }
+
+    // the latency that the given fraction (from 0 to 1) of the requests took at most, rounded up
+    // to the end of its bucket; zero without requests
+    std::chrono::nanoseconds percentile(const double fraction) const {
+        const uint64_t n = count();
+        if (n == 0)
+            return std::chrono::nanoseconds(0);
+        const auto rank = std::max<uint64_t>(
+            1, static_cast<uint64_t>(std::ceil(std::min(std::max(fraction, 0.0), 1.0) * n)));
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < buckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank)
+                return std::chrono::nanoseconds(lowerBound(i + 1) - 1);
+        }
+        return std::chrono::nanoseconds(lowerBound(buckets) - 1);
+    }
+
+    LatencyHistogram& operator+=(const LatencyHistogram& other) {
+        for (std::size_t i = 0; i < buckets; ++i) {
+            counts[i] += other.counts[i];
+        }
+        return *this;
+    }
+};
+
+// how tile requests were answered
+struct TileRequests {
+    uint64_t hits = 0;       // tiles that were in the index, or covered by polygons
+    uint64_t drillDowns = 0; // tiles that had to be sliced from a tile above first
+    uint64_t empty = 0;      // requests answered with an empty tile, as there was nothing there
+
+    // the number of drill-downs that sliced n zoom levels, at index n
+    std::vector<uint64_t> drillLevels = std::vector<uint64_t>(32, 0);
+
+    // time getTile and readTile took to find or build the tile
+    LatencyHistogram latency;
+
+    TileRequests& operator+=(const TileRequests& other) {
+        hits += other.hits;
+        drillDowns += other.drillDowns;
+        empty += other.empty;
+        for (std::size_t i = 0; i < drillLevels.size(); ++i) {
+            drillLevels[i] += other.drillLevels[i];
+        }
+        latency += other.latency;
+        return *this;
+    }
+};
+
+// the tile requests an index answered, as returned by GeoJSONVT::requestStats
+struct RequestStats {
+    TileRequests total;
+    std::map<uint8_t, TileRequests> zooms;
+};
+
+namespace detail {
+
+/* Counters of tile requests that threads update without locking. Like the shards of
+ * sharded_mutex, every thread counts in one of several shards of its own, so that threads reading
+ * tiles at the same zoom level don't write to the same cache lines; stats adds the shards up.
+ * The counters of a zoom level in a shard are only allocated on its first request there, so
+ * indexes that are never asked for tiles (like the subtrees built while drilling down) don't pay
+ * for them. A copy starts from zero.
+ */
+class request_counters {
+public:
+    request_counters() = default;
+
+    request_counters(const request_counters&) = delete;
+    request_counters& operator=(const request_counters&) = delete;
+
+    ~request_counters() {
+        for (auto& shard : shards) {
+            for (auto& z : shard) {
+                delete z.load();
+            }
+        }
+    }
+
+    void hit(const uint8_t z) {
+        at(z).hits.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void empty(const uint8_t z) {
+        at(z).empty.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void drilled(const uint8_t z, const uint8_t levels) {
+        auto& counters = at(z);
+        counters.drillDowns.fetch_add(1, std::memory_order_relaxed);
+        counters.levels[levels % 32].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void took(const uint8_t z, const std::chrono::steady_clock::time_point start) {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+        const auto nanoseconds = static_cast<uint64_t>(std::max<int64_t>(elapsed.count(), 0));
+        at(z).latency[LatencyHistogram::bucket(nanoseconds)].fetch_add(1,
+                                                                       std::memory_order_relaxed);
+    }
+
+    RequestStats stats() const {
+        RequestStats result;
+        for (const auto& shard : shards) {
+            for (std::size_t z = 0; z < shard.size(); ++z) {
+                const zoom_counters* counters = shard[z].load(std::memory_order_acquire);
+                if (!counters)
+                    continue;
+                TileRequests requests;
+                requests.hits = counters->hits.load(std::memory_order_relaxed);
+                requests.drillDowns = counters->drillDowns.load(std::memory_order_relaxed);
+                requests.empty = counters->empty.load(std::memory_order_relaxed);
+                for (std::size_t i = 0; i < counters->levels.size(); ++i) {
+                    requests.drillLevels[i] = counters->levels[i].load(std::memory_order_relaxed);
+                }
+                for (std::size_t i = 0; i < LatencyHistogram::buckets; ++i) {
+                    requests.latency.counts[i] =
+                        counters->latency[i].load(std::memory_order_relaxed);
+                }
+                result.total += requests;
+                result.zooms[static_cast<uint8_t>(z)] += requests;
+            }
+        }
+        return result;
+    }
+
+private:
+    // padded on both ends, so that the counters of different shards never share a cache line
+    struct zoom_counters {
+        char before[64];
+        std::atomic<uint64_t> hits{ 0 };
+        std::atomic<uint64_t> drillDowns{ 0 };
+        std::atomic<uint64_t> empty{ 0 };
+        std::array<std::atomic<uint64_t>, 32> levels{};
+        std::array<std::atomic<uint64_t>, LatencyHistogram::buckets> latency{};
+        char after[64];
+    };
+
+    // per shard, the counters of each zoom level; tile ids have 5 bits for the zoom
+    using zoom_slots = std::array<std::atomic<zoom_counters*>, 32>;
+    std::array<zoom_slots, 16> shards{};
+
+    zoom_counters& at(const uint8_t z) {
+        auto& slot = shards[threadShard(shards.size())][z % 32];
+        zoom_counters* counters = slot.load(std::memory_order_acquire);
+        if (counters)
+            return *counters;
+        auto* made = new zoom_counters();
+        if (slot.compare_exchange_strong(counters, made, std::memory_order_acq_rel))
+            return *made;
+        delete made; // another thread got there first
+        return *counters;
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
@@ -33,8 +33,9 @@ inline double getSqSegDist(const vt_point& p, const vt_point& a, const vt_point&
     return dx * dx + dy * dy;
 }
 
-// calculate simplification data using optimized Douglas-Peucker algorithm
-inline void simplify(std::vector<vt_point>& points, size_t first, size_t last, double sqTolerance) {
+// calculate simplification data using optimized Douglas-Peucker algorithm; points is the start of
+// the line or ring, which may be a range within a larger (flat) array
+inline void simplify(vt_point* points, size_t first, size_t last, double sqTolerance) {
     double maxSqDist = sqTolerance;
     size_t index = 0;
     const int64_t mid = (last - first) >> 1;
@@ -69,9 +70,7 @@ inline void simplify(std::vector<vt_point>& points, size_t first, size_t last, d
     }
 }
 
-inline void simplify(std::vector<vt_point>& points, double tolerance) {
-    const size_t len = points.size();
-
+inline void simplify(vt_point* points, const size_t len, double tolerance) {
     // always retain the endpoints (1 is the max value)
     points[0].z = 1.0;
     points[len - 1].z = 1.0;
@@ -79,6 +78,10 @@ inline void simplify(std::vector<vt_point>& points, double tolerance) {
     simplify(points, 0, len - 1, tolerance * tolerance);
 }
 
+inline void simplify(vt_vector<vt_point>& points, double tolerance) {
+    simplify(points.data(), points.size(), tolerance);
+}
+
 } // namespace detail
 } // namespace geojsonvt
 } // namespace mapbox
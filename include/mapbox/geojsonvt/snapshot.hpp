@@ -0,0 +1,1082 @@
+#pragma once
+
+#include <mapbox/geojsonvt/tile.hpp>
+#include <mapbox/geojsonvt/tile_map.hpp>
+#include <mapbox/geojsonvt/types.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+/* Layout of a snapshot file. Numbers are stored in the byte order of the machine that wrote it,
+ * which the reader checks against its own. A fixed header is followed by the options and these
+ * sections, each starting at an offset the header gives:
+ *
+ *   tiles       (Z-order key, offset) of every tile record, sorted by key
+ *   geometries  offset of every geometry record
+ *   properties  offset of every property map record
+ *   solids      top tile and shared output tile of every subtree covered by polygons
+ *
+ * Geometry and properties shared by features in several tiles are stored once, and tile records
+ * refer to them by index, so that they are shared again when the tiles are loaded.
+ */
+
+constexpr char snapshot_magic[4] = { 'G', 'V', 'T', 'S' };
+constexpr uint32_t snapshot_version = 2;
+constexpr uint32_t snapshot_byte_order = 0x01020304;
+constexpr size_t snapshot_header_size = 88;
+
+enum class geometry_tag : uint8_t {
+    empty,
+    point,
+    line_string,
+    polygon,
+    multi_point,
+    multi_line_string,
+    multi_polygon,
+    geometry_collection,
+    flat
+};
+
+enum class value_tag : uint8_t { null, boolean, uint, sint, number, string, vector, map };
+
+// appends numbers and strings to a buffer
+class byte_writer {
+public:
+    std::string bytes;
+
+    template <class T>
+    void put(const T value) {
+        static_assert(std::is_arithmetic<T>::value, "only numbers are written as they are");
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void put(const std::string& value) {
+        put(static_cast<uint32_t>(value.size()));
+        bytes.append(value);
+    }
+
+    // overwrite a number written earlier at the given offset
+    template <class T>
+    void set(const size_t offset, const T value) {
+        std::memcpy(&bytes[offset], &value, sizeof(T));
+    }
+
+    // pad with zeros up to a multiple of n bytes
+    void align(const size_t n) {
+        bytes.resize((bytes.size() + n - 1) / n * n, '\0');
+    }
+
+    size_t size() const {
+        return bytes.size();
+    }
+};
+
+// reads what a byte_writer wrote from a range of bytes, throwing when it would run past its end
+class byte_reader {
+public:
+    byte_reader(const char* data_, const size_t size_, const size_t offset = 0)
+        : data(data_), size(size_), pos(offset) {
+        if (pos > size)
+            truncated();
+    }
+
+    template <class T>
+    T get() {
+        static_assert(std::is_arithmetic<T>::value, "only numbers are read as they are");
+        need(sizeof(T));
+        T value;
+        std::memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string getString() {
+        const uint32_t length = get<uint32_t>();
+        need(length);
+        std::string value(data + pos, length);
+        pos += length;
+        return value;
+    }
+
+    // a number of items that take at least itemSize bytes each, checked against the bytes left,
+    // so that a damaged file can't make the reader allocate more than the file holds
+    uint32_t getCount(const size_t itemSize) {
+        const uint32_t count = get<uint32_t>();
+        if (itemSize != 0 && count > (size - pos) / itemSize)
+            truncated();
+        return count;
+    }
+
+private:
+    const char* data;
+    size_t size;
+    size_t pos;
+
+    void need(const size_t n) const {
+        if (n > size - pos)
+            truncated();
+    }
+
+    [[noreturn]] static void truncated() {
+        throw std::runtime_error("Snapshot is truncated or damaged");
+    }
+};
+
+struct point_writer {
+    byte_writer& out;
+
+    void operator()(const vt_point& p) const {
+        out.put(double(p.x));
+        out.put(double(p.y));
+        out.put(double(p.z));
+    }
+
+    template <class Points>
+    void operator()(const Points& points) const {
+        out.put(static_cast<uint32_t>(points.size()));
+        for (const auto& p : points) {
+            (*this)(p);
+        }
+    }
+};
+
+inline vt_point readPoint(byte_reader& in) {
+    const double x = in.get<double>();
+    const double y = in.get<double>();
+    const double z = in.get<double>();
+    return { x, y, z };
+}
+
+template <class Points>
+inline void readPoints(byte_reader& in, Points& points) {
+    const uint32_t count = in.getCount(3 * sizeof(double));
+    points.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        points.push_back(readPoint(in));
+    }
+}
+
+template <class T>
+inline void readNumbers(byte_reader& in, vt_vector<T>& numbers) {
+    const uint32_t count = in.getCount(sizeof(T));
+    numbers.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        numbers.push_back(in.get<T>());
+    }
+}
+
+struct geometry_writer {
+    byte_writer& out;
+
+    void tag(const geometry_tag t) const {
+        out.put(static_cast<uint8_t>(t));
+    }
+
+    void line(const vt_line_string& line) const {
+        point_writer{ out }(line);
+        out.put(line.dist);
+        out.put(line.segStart);
+        out.put(line.segEnd);
+    }
+
+    void polygon(const vt_polygon& polygon) const {
+        out.put(static_cast<uint32_t>(polygon.size()));
+        for (const auto& ring : polygon) {
+            point_writer{ out }(ring);
+            out.put(ring.area);
+        }
+    }
+
+    void operator()(const vt_empty&) const {
+        tag(geometry_tag::empty);
+    }
+
+    void operator()(const vt_point& point) const {
+        tag(geometry_tag::point);
+        point_writer{ out }(point);
+    }
+
+    void operator()(const vt_line_string& line_) const {
+        tag(geometry_tag::line_string);
+        line(line_);
+    }
+
+    void operator()(const vt_polygon& polygon_) const {
+        tag(geometry_tag::polygon);
+        polygon(polygon_);
+    }
+
+    void operator()(const vt_multi_point& points) const {
+        tag(geometry_tag::multi_point);
+        point_writer{ out }(points);
+    }
+
+    void operator()(const vt_multi_line_string& lines) const {
+        tag(geometry_tag::multi_line_string);
+        out.put(static_cast<uint32_t>(lines.size()));
+        for (const auto& l : lines) {
+            line(l);
+        }
+    }
+
+    void operator()(const vt_multi_polygon& polygons) const {
+        tag(geometry_tag::multi_polygon);
+        out.put(static_cast<uint32_t>(polygons.size()));
+        for (const auto& p : polygons) {
+            polygon(p);
+        }
+    }
+
+    void operator()(const vt_geometry_collection& geometries) const {
+        tag(geometry_tag::geometry_collection);
+        out.put(static_cast<uint32_t>(geometries.size()));
+        for (const auto& g : geometries) {
+            vt_geometry::visit(g, *this);
+        }
+    }
+
+    void operator()(const vt_flat_geometry& flat) const {
+        tag(geometry_tag::flat);
+        out.put(static_cast<uint8_t>(flat.type));
+        point_writer{ out }(flat.points);
+        out.put(static_cast<uint32_t>(flat.ends.size()));
+        for (const uint32_t end : flat.ends) {
+            out.put(end);
+        }
+        out.put(static_cast<uint32_t>(flat.measures.size()));
+        for (const double measure : flat.measures) {
+            out.put(measure);
+        }
+        out.put(static_cast<uint32_t>(flat.polygons.size()));
+        for (const uint32_t end : flat.polygons) {
+            out.put(end);
+        }
+    }
+};
+
+inline vt_line_string readLine(byte_reader& in) {
+    vt_line_string line;
+    readPoints(in, line);
+    line.dist = in.get<double>();
+    line.segStart = in.get<double>();
+    line.segEnd = in.get<double>();
+    return line;
+}
+
+inline vt_polygon readPolygon(byte_reader& in) {
+    vt_polygon polygon;
+    const uint32_t count = in.getCount(sizeof(uint32_t) + sizeof(double));
+    polygon.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        vt_linear_ring ring;
+        readPoints(in, ring);
+        ring.area = in.get<double>();
+        polygon.push_back(std::move(ring));
+    }
+    return polygon;
+}
+
+inline vt_geometry readGeometry(byte_reader& in) {
+    switch (static_cast<geometry_tag>(in.get<uint8_t>())) {
+    case geometry_tag::empty:
+        return vt_empty{};
+    case geometry_tag::point:
+        return readPoint(in);
+    case geometry_tag::line_string:
+        return readLine(in);
+    case geometry_tag::polygon:
+        return readPolygon(in);
+    case geometry_tag::multi_point: {
+        vt_multi_point points;
+        readPoints(in, points);
+        return points;
+    }
+    case geometry_tag::multi_line_string: {
+        vt_multi_line_string lines;
+        const uint32_t count = in.getCount(sizeof(uint32_t) + 3 * sizeof(double));
+        lines.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            lines.push_back(readLine(in));
+        }
+        return lines;
+    }
+    case geometry_tag::multi_polygon: {
+        vt_multi_polygon polygons;
+        const uint32_t count = in.getCount(sizeof(uint32_t));
+        polygons.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            polygons.push_back(readPolygon(in));
+        }
+        return polygons;
+    }
+    case geometry_tag::geometry_collection: {
+        vt_geometry_collection geometries;
+        const uint32_t count = in.getCount(sizeof(uint8_t));
+        geometries.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            geometries.push_back(readGeometry(in));
+        }
+        return geometries;
+    }
+    case geometry_tag::flat: {
+        const auto type = in.get<uint8_t>();
+        if (type > static_cast<uint8_t>(vt_flat_geometry::shape::polygon))
+            break;
+        vt_flat_geometry flat(static_cast<vt_flat_geometry::shape>(type));
+        readPoints(in, flat.points);
+        readNumbers(in, flat.ends);
+        readNumbers(in, flat.measures);
+        readNumbers(in, flat.polygons);
+        return flat;
+    }
+    }
+    throw std::runtime_error("Snapshot has a geometry of unknown type");
+}
+
+// the geometry of output tiles, with integer coordinates and no extra measures
+struct tile_geometry_writer {
+    byte_writer& out;
+
+    void tag(const geometry_tag t) const {
+        out.put(static_cast<uint8_t>(t));
+    }
+
+    void points(const std::vector<mapbox::geometry::point<int16_t>>& points_) const {
+        out.put(static_cast<uint32_t>(points_.size()));
+        for (const auto& p : points_) {
+            out.put(p.x);
+            out.put(p.y);
+        }
+    }
+
+    template <class Rings>
+    void rings(const Rings& rings_) const {
+        out.put(static_cast<uint32_t>(rings_.size()));
+        for (const auto& ring : rings_) {
+            points(ring);
+        }
+    }
+
+    void operator()(const mapbox::geometry::empty&) const {
+        tag(geometry_tag::empty);
+    }
+
+    void operator()(const mapbox::geometry::point<int16_t>& point) const {
+        tag(geometry_tag::point);
+        out.put(point.x);
+        out.put(point.y);
+    }
+
+    void operator()(const mapbox::geometry::line_string<int16_t>& line) const {
+        tag(geometry_tag::line_string);
+        points(line);
+    }
+
+    void operator()(const mapbox::geometry::polygon<int16_t>& polygon) const {
+        tag(geometry_tag::polygon);
+        rings(polygon);
+    }
+
+    void operator()(const mapbox::geometry::multi_point<int16_t>& points_) const {
+        tag(geometry_tag::multi_point);
+        points(points_);
+    }
+
+    void operator()(const mapbox::geometry::multi_line_string<int16_t>& lines) const {
+        tag(geometry_tag::multi_line_string);
+        rings(lines);
+    }
+
+    void operator()(const mapbox::geometry::multi_polygon<int16_t>& polygons) const {
+        tag(geometry_tag::multi_polygon);
+        out.put(static_cast<uint32_t>(polygons.size()));
+        for (const auto& polygon : polygons) {
+            rings(polygon);
+        }
+    }
+
+    void operator()(const mapbox::geometry::geometry_collection<int16_t>& geometries) const {
+        tag(geometry_tag::geometry_collection);
+        out.put(static_cast<uint32_t>(geometries.size()));
+        for (const auto& g : geometries) {
+            mapbox::geometry::geometry<int16_t>::visit(g, *this);
+        }
+    }
+};
+
+template <class Points>
+inline void readTilePoints(byte_reader& in, Points& points) {
+    const uint32_t count = in.getCount(2 * sizeof(int16_t));
+    points.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const int16_t x = in.get<int16_t>();
+        const int16_t y = in.get<int16_t>();
+        points.emplace_back(x, y);
+    }
+}
+
+template <class Rings>
+inline void readTileRings(byte_reader& in, Rings& rings) {
+    const uint32_t count = in.getCount(sizeof(uint32_t));
+    rings.resize(count);
+    for (auto& ring : rings) {
+        readTilePoints(in, ring);
+    }
+}
+
+inline mapbox::geometry::geometry<int16_t> readTileGeometry(byte_reader& in) {
+    switch (static_cast<geometry_tag>(in.get<uint8_t>())) {
+    case geometry_tag::empty:
+        return mapbox::geometry::empty{};
+    case geometry_tag::point: {
+        const int16_t x = in.get<int16_t>();
+        const int16_t y = in.get<int16_t>();
+        return mapbox::geometry::point<int16_t>(x, y);
+    }
+    case geometry_tag::line_string: {
+        mapbox::geometry::line_string<int16_t> line;
+        readTilePoints(in, line);
+        return line;
+    }
+    case geometry_tag::polygon: {
+        mapbox::geometry::polygon<int16_t> polygon;
+        readTileRings(in, polygon);
+        return polygon;
+    }
+    case geometry_tag::multi_point: {
+        mapbox::geometry::multi_point<int16_t> points;
+        readTilePoints(in, points);
+        return points;
+    }
+    case geometry_tag::multi_line_string: {
+        mapbox::geometry::multi_line_string<int16_t> lines;
+        readTileRings(in, lines);
+        return lines;
+    }
+    case geometry_tag::multi_polygon: {
+        mapbox::geometry::multi_polygon<int16_t> polygons;
+        polygons.resize(in.getCount(sizeof(uint32_t)));
+        for (auto& polygon : polygons) {
+            readTileRings(in, polygon);
+        }
+        return polygons;
+    }
+    case geometry_tag::geometry_collection: {
+        mapbox::geometry::geometry_collection<int16_t> geometries;
+        const uint32_t count = in.getCount(sizeof(uint8_t));
+        for (uint32_t i = 0; i < count; ++i) {
+            geometries.push_back(readTileGeometry(in));
+        }
+        return geometries;
+    }
+    default:
+        break;
+    }
+    throw std::runtime_error("Snapshot has a geometry of unknown type");
+}
+
+inline void writeValue(byte_writer& out, const mapbox::feature::value& value);
+
+inline void writeProperties(byte_writer& out, const property_map& properties) {
+    out.put(static_cast<uint32_t>(properties.size()));
+    for (const auto& pair : properties) {
+        out.put(pair.first);
+        writeValue(out, pair.second);
+    }
+}
+
+inline void writeValue(byte_writer& out, const mapbox::feature::value& value) {
+    const auto tag = [&](const value_tag t) { out.put(static_cast<uint8_t>(t)); };
+
+    if (value.is<bool>()) {
+        tag(value_tag::boolean);
+        out.put(static_cast<uint8_t>(value.get<bool>()));
+    } else if (value.is<uint64_t>()) {
+        tag(value_tag::uint);
+        out.put(value.get<uint64_t>());
+    } else if (value.is<int64_t>()) {
+        tag(value_tag::sint);
+        out.put(value.get<int64_t>());
+    } else if (value.is<double>()) {
+        tag(value_tag::number);
+        out.put(value.get<double>());
+    } else if (value.is<std::string>()) {
+        tag(value_tag::string);
+        out.put(value.get<std::string>());
+    } else if (value.is<std::vector<mapbox::feature::value>>()) {
+        const auto& values = value.get<std::vector<mapbox::feature::value>>();
+        tag(value_tag::vector);
+        out.put(static_cast<uint32_t>(values.size()));
+        for (const auto& v : values) {
+            writeValue(out, v);
+        }
+    } else if (value.is<property_map>()) {
+        tag(value_tag::map);
+        writeProperties(out, value.get<property_map>());
+    } else {
+        tag(value_tag::null);
+    }
+}
+
+inline mapbox::feature::value readValue(byte_reader& in);
+
+inline property_map readProperties(byte_reader& in) {
+    property_map properties;
+    const uint32_t count = in.getCount(sizeof(uint32_t) + sizeof(uint8_t));
+    properties.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto key = in.getString();
+        properties.emplace(std::move(key), readValue(in));
+    }
+    return properties;
+}
+
+inline mapbox::feature::value readValue(byte_reader& in) {
+    switch (static_cast<value_tag>(in.get<uint8_t>())) {
+    case value_tag::null:
+        return mapbox::feature::null_value;
+    case value_tag::boolean:
+        return in.get<uint8_t>() != 0;
+    case value_tag::uint:
+        return in.get<uint64_t>();
+    case value_tag::sint:
+        return in.get<int64_t>();
+    case value_tag::number:
+        return in.get<double>();
+    case value_tag::string:
+        return in.getString();
+    case value_tag::vector: {
+        std::vector<mapbox::feature::value> values;
+        const uint32_t count = in.getCount(sizeof(uint8_t));
+        values.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            values.push_back(readValue(in));
+        }
+        return values;
+    }
+    case value_tag::map:
+        return readProperties(in);
+    }
+    throw std::runtime_error("Snapshot has a value of unknown type");
+}
+
+inline void writeIdentifier(byte_writer& out, const identifier& id) {
+    const auto tag = [&](const value_tag t) { out.put(static_cast<uint8_t>(t)); };
+
+    if (id.is<uint64_t>()) {
+        tag(value_tag::uint);
+        out.put(id.get<uint64_t>());
+    } else if (id.is<int64_t>()) {
+        tag(value_tag::sint);
+        out.put(id.get<int64_t>());
+    } else if (id.is<double>()) {
+        tag(value_tag::number);
+        out.put(id.get<double>());
+    } else if (id.is<std::string>()) {
+        tag(value_tag::string);
+        out.put(id.get<std::string>());
+    } else {
+        tag(value_tag::null);
+    }
+}
+
+inline identifier readIdentifier(byte_reader& in) {
+    switch (static_cast<value_tag>(in.get<uint8_t>())) {
+    case value_tag::null:
+        return mapbox::feature::null_value;
+    case value_tag::uint:
+        return in.get<uint64_t>();
+    case value_tag::sint:
+        return in.get<int64_t>();
+    case value_tag::number:
+        return in.get<double>();
+    case value_tag::string:
+        return in.getString();
+    default:
+        break;
+    }
+    throw std::runtime_error("Snapshot has a feature id of unknown type");
+}
+
+inline void writeTile(byte_writer& out, const Tile& tile) {
+    out.put(tile.num_points);
+    out.put(tile.num_simplified);
+    out.put(static_cast<uint32_t>(tile.features.size()));
+    for (const auto& feature : tile.features) {
+        mapbox::geometry::geometry<int16_t>::visit(feature.geometry, tile_geometry_writer{ out });
+        writeProperties(out, feature.properties);
+        writeIdentifier(out, feature.id);
+    }
+}
+
+inline Tile readTile(byte_reader& in) {
+    Tile tile;
+    tile.num_points = in.get<uint32_t>();
+    tile.num_simplified = in.get<uint32_t>();
+    const uint32_t count = in.getCount(3 * sizeof(uint8_t) + sizeof(uint32_t));
+    tile.features.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        auto geometry = readTileGeometry(in);
+        auto properties = readProperties(in);
+        auto id = readIdentifier(in);
+        tile.features.push_back({ std::move(geometry), std::move(properties), std::move(id) });
+    }
+    return tile;
+}
+
+// the whole of a file, mapped into memory where the platform allows it, so that its pages are
+// only read from disk when they're first touched, and read into memory otherwise
+class mapped_file {
+public:
+    explicit mapped_file(const std::string& path) {
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Can't open snapshot " + path);
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        bytes = buffer.data();
+        length = buffer.size();
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Can't open snapshot " + path);
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Can't open snapshot " + path);
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length != 0) {
+            void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("Can't map snapshot " + path);
+            }
+            bytes = static_cast<const char*>(mapped);
+        }
+        ::close(fd); // the mapping stays valid without it
+#endif
+    }
+
+    ~mapped_file() {
+#ifndef _WIN32
+        if (bytes)
+            ::munmap(const_cast<char*>(bytes), length);
+#endif
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    const char* data() const {
+        return bytes;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::string buffer;
+#endif
+};
+
+// everything saved about a tile: its source features, or, for a tile that was sliced further,
+// its output tile and the source points of each of its features
+struct saved_tile {
+    vt_features features;
+    uint32_t num_points = 0;
+    mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
+    bool sliced = false;
+    Tile output;
+    std::vector<uint32_t> points;
+};
+
+// builds a snapshot file in memory, to be written out with save
+class snapshot_writer {
+public:
+    snapshot_writer() {
+        header.bytes.append(snapshot_magic, sizeof(snapshot_magic));
+        header.put(snapshot_version);
+        header.put(snapshot_byte_order);
+        header.bytes.resize(snapshot_header_size, '\0');
+    }
+
+    // the writer for the options, which follow the header
+    byte_writer& options() {
+        return header;
+    }
+
+    void addTile(const InternalTile& tile) {
+        const bool sliced = tile.source_features.empty() && tile.num_points != 0;
+        addTile(tile.z, tile.x, tile.y, tile.source_features, tile.num_points, tile.bbox,
+                sliced ? &tile.tile() : nullptr, tile.outputPoints());
+    }
+
+    void addTile(const uint8_t z, const uint32_t x, const uint32_t y, const saved_tile& tile) {
+        addTile(z, x, y, tile.features, tile.num_points, tile.bbox,
+                tile.sliced ? &tile.output : nullptr, tile.points);
+    }
+
+    void addSolid(const uint8_t z, const uint32_t x, const uint32_t y, const Tile& tile) {
+        ++solidCount;
+        solids.put(z);
+        solids.put(x);
+        solids.put(y);
+        writeTile(solids, tile);
+    }
+
+    // write the snapshot to the given path, through a temporary file that replaces it at once, so
+    // that processes that have the old file open keep reading the old one
+    void save(const std::string& path) {
+        byte_writer out = std::move(header);
+        out.align(8);
+
+        std::sort(directory.begin(), directory.end());
+        const size_t tilesOffset = out.size();
+        const size_t geometriesOffset = tilesOffset + directory.size() * 16;
+        const size_t propertiesOffset = geometriesOffset + geometryOffsets.size() * 8;
+        const size_t solidsOffset = propertiesOffset + propertyOffsets.size() * 8;
+        const size_t geometryBase = solidsOffset + solids.size();
+        const size_t propertyBase = geometryBase + geometries.size();
+        const size_t recordBase = propertyBase + properties.size();
+
+        for (const auto& entry : directory) {
+            out.put(entry.first);
+            out.put(static_cast<uint64_t>(recordBase + entry.second));
+        }
+        for (const uint64_t offset : geometryOffsets) {
+            out.put(static_cast<uint64_t>(geometryBase + offset));
+        }
+        for (const uint64_t offset : propertyOffsets) {
+            out.put(static_cast<uint64_t>(propertyBase + offset));
+        }
+        out.bytes.append(solids.bytes);
+        out.bytes.append(geometries.bytes);
+        out.bytes.append(properties.bytes);
+        out.bytes.append(records.bytes);
+
+        const uint64_t sections[] = { directory.size(),       tilesOffset,
+                                      geometryOffsets.size(), geometriesOffset,
+                                      propertyOffsets.size(), propertiesOffset,
+                                      solidCount,             solidsOffset };
+        for (size_t i = 0; i < 8; ++i) {
+            out.set(16 + i * 8, sections[i]);
+        }
+
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(out.bytes.data(), static_cast<std::streamsize>(out.size()));
+            if (!file.flush())
+                throw std::runtime_error("Can't write snapshot " + temporary);
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Can't write snapshot " + path);
+        }
+    }
+
+private:
+    byte_writer header;
+    byte_writer records;
+    byte_writer geometries;
+    byte_writer properties;
+    byte_writer solids;
+    uint64_t solidCount = 0;
+
+    std::vector<std::pair<uint64_t, uint64_t>> directory;
+    std::vector<uint64_t> geometryOffsets;
+    std::vector<uint64_t> propertyOffsets;
+    std::unordered_map<const vt_geometry*, uint32_t> geometryIndex;
+    std::unordered_map<const property_map*, uint32_t> propertyIndex;
+
+    void addTile(const uint8_t z,
+                 const uint32_t x,
+                 const uint32_t y,
+                 const vt_features& features,
+                 const uint32_t numPoints,
+                 const mapbox::geometry::box<double>& bbox,
+                 const Tile* output,
+                 const std::vector<uint32_t>& points) {
+        directory.emplace_back(zOrderKey(z, x, y), records.size());
+        records.put(numPoints);
+        records.put(bbox.min.x);
+        records.put(bbox.min.y);
+        records.put(bbox.max.x);
+        records.put(bbox.max.y);
+
+        records.put(static_cast<uint32_t>(features.size()));
+        for (const auto& feature : features) {
+            records.put(geometryAt(*feature.geometry));
+            records.put(propertiesAt(*feature.properties));
+            writeIdentifier(records, feature.id);
+        }
+
+        records.put(static_cast<uint8_t>(output != nullptr));
+        if (output) {
+            writeTile(records, *output);
+            records.put(static_cast<uint32_t>(points.size()));
+            for (const uint32_t n : points) {
+                records.put(n);
+            }
+        }
+    }
+
+    uint32_t geometryAt(const vt_geometry& geometry) {
+        const auto it = geometryIndex.find(&geometry);
+        if (it != geometryIndex.end())
+            return it->second;
+        const auto index = static_cast<uint32_t>(geometryOffsets.size());
+        geometryOffsets.push_back(geometries.size());
+        vt_geometry::visit(geometry, geometry_writer{ geometries });
+        geometryIndex.emplace(&geometry, index);
+        return index;
+    }
+
+    uint32_t propertiesAt(const property_map& map) {
+        const auto it = propertyIndex.find(&map);
+        if (it != propertyIndex.end())
+            return it->second;
+        const auto index = static_cast<uint32_t>(propertyOffsets.size());
+        propertyOffsets.push_back(properties.size());
+        writeProperties(properties, map);
+        propertyIndex.emplace(&map, index);
+        return index;
+    }
+};
+
+/* A snapshot file opened for reading. The directory of tiles is searched in place in the mapped
+ * file; a tile is only decoded when it's read, and geometry and property maps are decoded the
+ * first time a tile refers to them, then shared with every other tile that does. Copies share the
+ * file, but not what they decoded from it. Not safe to use from several threads at once.
+ */
+class snapshot {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    snapshot() = default;
+
+    explicit snapshot(const std::string& path) : file(std::make_shared<const mapped_file>(path)) {
+        const char* data = file->data();
+        const size_t size = file->size();
+
+        if (size < snapshot_header_size ||
+            std::memcmp(data, snapshot_magic, sizeof(snapshot_magic)) != 0)
+            throw std::runtime_error("Not a snapshot: " + path);
+
+        byte_reader header(data, size, sizeof(snapshot_magic));
+        const uint32_t version = header.get<uint32_t>();
+        if (version != snapshot_version)
+            throw std::runtime_error("Unsupported snapshot version " + std::to_string(version));
+        if (header.get<uint32_t>() != snapshot_byte_order)
+            throw std::runtime_error("Snapshot was written with another byte order");
+
+        header = byte_reader(data, size, 16);
+        tileCount = section(header, 16);
+        tilesOffset = offset;
+        geometryCount = section(header, 8);
+        geometriesOffset = offset;
+        propertyCount = section(header, 8);
+        propertiesOffset = offset;
+        solidCount = section(header, 0);
+        solidsOffset = offset;
+
+        taken.assign(tileCount, false);
+        geometries.resize(geometryCount);
+        properties.resize(propertyCount);
+    }
+
+    bool empty() const {
+        return tileCount == 0;
+    }
+
+    // number of tiles in the file
+    size_t size() const {
+        return tileCount;
+    }
+
+    // a reader for the options, which follow the header
+    byte_reader options() const {
+        return { file->data(), file->size(), snapshot_header_size };
+    }
+
+    // calls f(z, x, y, tile) for every subtree covered by polygons
+    template <class F>
+    void eachSolid(F&& f) const {
+        byte_reader in(file->data(), file->size(), solidsOffset);
+        for (uint64_t i = 0; i < solidCount; ++i) {
+            const auto z = in.get<uint8_t>();
+            const auto x = in.get<uint32_t>();
+            const auto y = in.get<uint32_t>();
+            f(z, x, y, std::make_shared<const Tile>(readTile(in)));
+        }
+    }
+
+    // position of tile z/x/y in the file, unless it isn't there or was taken already
+    size_t find(const uint8_t z, const uint32_t x, const uint32_t y) const {
+        const uint64_t k = zOrderKey(z, x, y);
+        const size_t i = lowerBound(k);
+        if (i == tileCount || key(i) != k || taken[i])
+            return npos;
+        return i;
+    }
+
+    bool isTaken(const size_t i) const {
+        return taken[i];
+    }
+
+    // mark tile i as taken, after which find no longer returns it: for tiles that were loaded,
+    // or that changed since the snapshot was written
+    void take(const size_t i) {
+        taken[i] = true;
+    }
+
+    // take tile z/x/y and every tile under it, calling f(z, x, y) for each one that wasn't taken
+    template <class F>
+    void takeAll(const uint8_t z, const uint32_t x, const uint32_t y, F&& f) {
+        const uint64_t end = zOrderEnd(z, x, y);
+        for (size_t i = lowerBound(zOrderKey(z, x, y)); i < tileCount && key(i) < end; ++i) {
+            if (taken[i])
+                continue;
+            taken[i] = true;
+            const auto tile = fromZOrderKey(key(i));
+            f(std::get<0>(tile), std::get<1>(tile), std::get<2>(tile));
+        }
+    }
+
+    // the zoom and coordinates of tile i
+    std::tuple<uint8_t, uint32_t, uint32_t> coordinates(const size_t i) const {
+        return fromZOrderKey(key(i));
+    }
+
+    // decode tile i
+    saved_tile read(const size_t i) {
+        byte_reader in(file->data(), file->size(), number(tilesOffset + i * 16 + 8));
+        saved_tile tile;
+        tile.num_points = in.get<uint32_t>();
+        tile.bbox.min.x = in.get<double>();
+        tile.bbox.min.y = in.get<double>();
+        tile.bbox.max.x = in.get<double>();
+        tile.bbox.max.y = in.get<double>();
+
+        const uint32_t count = in.getCount(2 * sizeof(uint32_t) + sizeof(uint8_t));
+        tile.features.reserve(count);
+        for (uint32_t f = 0; f < count; ++f) {
+            auto geometry = geometryAt(in.get<uint32_t>());
+            const auto props = propertiesAt(in.get<uint32_t>());
+            tile.features.emplace_back(std::move(geometry), props, readIdentifier(in));
+        }
+
+        tile.sliced = in.get<uint8_t>() != 0;
+        if (tile.sliced) {
+            tile.output = readTile(in);
+            const uint32_t points = in.getCount(sizeof(uint32_t));
+            tile.points.reserve(points);
+            for (uint32_t p = 0; p < points; ++p) {
+                tile.points.push_back(in.get<uint32_t>());
+            }
+        }
+        return tile;
+    }
+
+private:
+    std::shared_ptr<const mapped_file> file;
+
+    uint64_t tileCount = 0;
+    uint64_t tilesOffset = 0;
+    uint64_t geometryCount = 0;
+    uint64_t geometriesOffset = 0;
+    uint64_t propertyCount = 0;
+    uint64_t propertiesOffset = 0;
+    uint64_t solidCount = 0;
+    uint64_t solidsOffset = 0;
+    uint64_t offset = 0;
+
+    std::vector<bool> taken;
+    std::vector<std::shared_ptr<const vt_geometry>> geometries;
+    std::vector<std::shared_ptr<const property_map>> properties;
+
+    // read the count and offset of a section with entries of the given size, checking that they
+    // fit in the file; leaves the offset in offset
+    uint64_t section(byte_reader& header, const size_t entrySize) {
+        const uint64_t count = header.get<uint64_t>();
+        offset = header.get<uint64_t>();
+        if (offset > file->size() ||
+            (entrySize != 0 && count > (file->size() - offset) / entrySize))
+            throw std::runtime_error("Snapshot is truncated or damaged");
+        return count;
+    }
+
+    uint64_t number(const size_t at) const {
+        return byte_reader(file->data(), file->size(), at).get<uint64_t>();
+    }
+
+    uint64_t key(const size_t i) const {
+        return number(tilesOffset + i * 16);
+    }
+
+    size_t lowerBound(const uint64_t k) const {
+        size_t first = 0;
+        size_t count = tileCount;
+        while (count > 0) {
+            const size_t step = count / 2;
+            if (key(first + step) < k) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+        return first;
+    }
+
+    std::shared_ptr<const vt_geometry> geometryAt(const uint32_t i) {
+        if (i >= geometryCount)
+            throw std::runtime_error("Snapshot is truncated or damaged");
+        if (!geometries[i]) {
+            byte_reader in(file->data(), file->size(), number(geometriesOffset + i * 8));
+            geometries[i] = makeShared<vt_geometry>(readGeometry(in));
+        }
+        return geometries[i];
+    }
+
+    std::shared_ptr<const property_map> propertiesAt(const uint32_t i) {
+        if (i >= propertyCount)
+            throw std::runtime_error("Snapshot is truncated or damaged");
+        if (!properties[i]) {
+            byte_reader in(file->data(), file->size(), number(propertiesOffset + i * 8));
+            properties[i] = makeShared<property_map>(readProperties(in));
+        }
+        return properties[i];
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
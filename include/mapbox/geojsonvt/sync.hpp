@@ -0,0 +1,298 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+// a member (such as a mutex) that is default constructed again whenever the object holding it is
+// copied or moved, instead of being copied along
+template <class T>
+struct fresh : T {
+    fresh() = default;
+
+    fresh(const fresh&) : T() {
+    }
+
+    fresh& operator=(const fresh&) {
+        return *this;
+    }
+};
+
+// like std::once_flag, but a single byte and copyable (a copy of a flag that is set is set);
+// the rare callers that race to run the same flag wait on a mutex shared with other flags
+class once {
+public:
+    once() = default;
+
+    once(const once& other) : done(other.done.load()) {
+    }
+
+    once& operator=(const once& other) {
+        done.store(other.done.load());
+        return *this;
+    }
+
+    template <class F>
+    void call(F&& f) {
+        if (done.load(std::memory_order_acquire))
+            return;
+        std::lock_guard<std::mutex> lock(stripe(this));
+        if (done.load(std::memory_order_relaxed))
+            return;
+        f();
+        done.store(true, std::memory_order_release);
+    }
+
+    bool called() const {
+        return done.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<bool> done{ false };
+
+    static std::mutex& stripe(const void* flag) {
+        static std::array<std::mutex, 64> mutexes;
+        return mutexes[(reinterpret_cast<std::uintptr_t>(flag) >> 4) % mutexes.size()];
+    }
+};
+
+// one of count shards, picked by the calling thread and the same on every call from it
+inline std::size_t threadShard(const std::size_t count) {
+    static thread_local const std::size_t hash =
+        std::hash<std::thread::id>()(std::this_thread::get_id());
+    return hash % count;
+}
+
+/* A reader-writer lock split into cache-line sized shards. A reader only locks the shard picked by
+ * its thread, so readers on different threads never write to the same cache line; a writer locks
+ * every shard in turn. Meets the Lockable and SharedLockable requirements.
+ */
+
+class sharded_mutex {
+public:
+    void lock_shared() {
+        shards[shard()].mutex.lock_shared();
+    }
+
+    void unlock_shared() {
+        shards[shard()].mutex.unlock_shared();
+    }
+
+    void lock() {
+        for (auto& s : shards) {
+            s.mutex.lock();
+        }
+    }
+
+    void unlock() {
+        for (auto it = shards.rbegin(); it != shards.rend(); ++it) {
+            it->mutex.unlock();
+        }
+    }
+
+private:
+    static constexpr std::size_t count = 16;
+
+    struct alignas(64) padded {
+        std::shared_timed_mutex mutex;
+    };
+
+    std::array<padded, count> shards;
+
+    static std::size_t shard() {
+        return threadShard(count);
+    }
+};
+
+// number of tiles per zoom level, readable while other threads add or remove tiles
+class tile_counters {
+public:
+    tile_counters() {
+        reset();
+    }
+
+    tile_counters(const tile_counters& other) {
+        *this = other;
+    }
+
+    tile_counters& operator=(const tile_counters& other) {
+        for (std::size_t z = 0; z < zooms; ++z) {
+            counts[z].store(other.counts[z].load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+        }
+        sum.store(other.sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    void add(const uint8_t z) {
+        counts[z % zooms].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void remove(const uint8_t z) {
+        counts[z % zooms].fetch_sub(1, std::memory_order_relaxed);
+        sum.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    uint32_t get(const uint8_t z) const {
+        return counts[z % zooms].load(std::memory_order_relaxed);
+    }
+
+    uint32_t total() const {
+        return sum.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr std::size_t zooms = 32; // tile ids have 5 bits for the zoom
+
+    std::array<std::atomic<uint32_t>, zooms> counts;
+    std::atomic<uint32_t> sum;
+
+    void reset() {
+        for (auto& c : counts) {
+            c.store(0, std::memory_order_relaxed);
+        }
+        sum.store(0, std::memory_order_relaxed);
+    }
+};
+
+/* A queue of tasks per worker thread. A worker takes its own most recently added task first, so
+ * that it goes depth first through its part of the work, and when it runs out takes the oldest
+ * task of another worker, which tends to be the biggest piece of work that one has left. A worker
+ * that finds nothing to take tries a few more times and then sleeps until a task is pushed or
+ * the work is done, so that a long tail of work doesn't keep idle workers spinning.
+ */
+
+template <class Task>
+class work_queues {
+public:
+    explicit work_queues(const std::size_t workers) : queues(workers) {
+    }
+
+    void push(const std::size_t worker, Task task) {
+        unfinished.fetch_add(1);
+        {
+            auto& q = queues[worker];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(std::move(task));
+            queued.fetch_add(1);
+        }
+        if (sleeping.load() != 0) {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            idle.notify_one();
+        }
+    }
+
+    // runs process(worker, task) for every task, including ones pushed by process itself, with a
+    // thread per queue, until none are left; rethrows the first exception a task throws
+    template <class Process>
+    void run(Process&& process) {
+        std::exception_ptr error;
+        std::mutex errorMutex;
+        std::atomic<bool> failed(false);
+
+        const auto wakeAll = [&] {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            idle.notify_all();
+        };
+
+        const auto work = [&](const std::size_t worker) {
+            std::size_t misses = 0;
+            while (unfinished.load() != 0 && !failed.load()) {
+                Task task;
+                if (!pop(worker, task)) {
+                    if (++misses < spins) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> lock(idleMutex);
+                    sleeping.fetch_add(1);
+                    idle.wait(lock, [&] {
+                        return queued.load() != 0 || unfinished.load() == 0 || failed.load();
+                    });
+                    sleeping.fetch_sub(1);
+                    continue;
+                }
+                misses = 0;
+                try {
+                    process(worker, std::move(task));
+                } catch (...) {
+                    {
+                        std::lock_guard<std::mutex> lock(errorMutex);
+                        if (!error)
+                            error = std::current_exception();
+                    }
+                    failed.store(true);
+                    wakeAll();
+                }
+                if (unfinished.fetch_sub(1) == 1)
+                    wakeAll();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (std::size_t worker = 1; worker < queues.size(); ++worker) {
+            threads.emplace_back(work, worker);
+        }
+        work(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+private:
+    struct queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    static constexpr std::size_t spins = 64; // failed attempts to take a task before sleeping
+
+    std::vector<queue> queues;
+    std::atomic<std::size_t> unfinished{ 0 }; // pushed, but not processed yet
+    std::atomic<std::size_t> queued{ 0 };     // pushed, but not taken yet
+
+    // idle workers sleep on idle; a push only takes idleMutex when one of them is sleeping
+    std::atomic<std::size_t> sleeping{ 0 };
+    std::mutex idleMutex;
+    std::condition_variable idle;
+
+    bool pop(const std::size_t worker, Task& task) {
+        for (std::size_t i = 0; i < queues.size(); ++i) {
+            auto& q = queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty())
+                continue;
+            if (i == 0) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            } else {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            queued.fetch_sub(1);
+            return true;
+        }
+        return false;
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
@@ -2,6 +2,10 @@
 
 #include <algorithm>
 #include <cmath>
+#include <memory>
+#include <vector>
+#include <mapbox/geojsonvt/observer.hpp>
+#include <mapbox/geojsonvt/sync.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 
 namespace mapbox {
@@ -29,8 +33,12 @@ public:
 
     vt_features source_features;
     mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
+    uint32_t num_points = 0;
 
-    Tile tile;
+#ifdef GEOJSONVT_OBSERVE
+    // where building the output tile is reported, if anywhere
+    Observer* observer = nullptr;
+#endif
 
     InternalTile(const vt_features& source,
                  const uint8_t z_,
@@ -49,60 +57,183 @@ public:
           lineMetrics(lineMetrics_) {
 
         for (const auto& feature : source) {
-            const auto& geom = feature.geometry;
-            const auto& props = feature.properties;
-            const auto& id = feature.id;
+            num_points += feature.num_points;
 
-            tile.num_points += feature.num_points;
+            bbox.min.x = std::min(feature.bbox.min.x, bbox.min.x);
+            bbox.min.y = std::min(feature.bbox.min.y, bbox.min.y);
+            bbox.max.x = std::max(feature.bbox.max.x, bbox.max.x);
+            bbox.max.y = std::max(feature.bbox.max.y, bbox.max.y);
+        }
+    }
 
-            vt_geometry::visit(geom, [&](const auto& g) {
-                // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
-                this->addFeature(g, props, id);
-            });
+    // the output tile, built from source_features the first time it's asked for
+    const Tile& tile() const {
+        return materialize(source_features);
+    }
+
+    // the output tile, built from the given features if it hasn't been built yet; must be called
+    // before the features a tile was made from are dropped
+    const Tile& materialize(const vt_features& source) const {
+        built.call([&] { build(source); });
+        return output;
+    }
+
+    // drop the features with any of the given sorted ids from the source features and, if it was
+    // built, from the output tile; returns whether the tile had any of them
+    bool remove(const std::vector<identifier>& ids) {
+        const auto listed = [&](const identifier& id) {
+            return std::binary_search(ids.begin(), ids.end(), id);
+        };
+        const bool sliced = source_features.empty();
+        bool found = false;
+
+        const auto end = std::remove_if(source_features.begin(), source_features.end(),
+                                        [&](const vt_feature& feature) {
+                                            if (!listed(feature.id))
+                                                return false;
+                                            num_points -= feature.num_points;
+                                            return true;
+                                        });
+        found = end != source_features.end();
+        source_features.erase(end, source_features.end());
+
+        if (!built.called())
+            return found;
+
+        size_t kept = 0;
+        for (size_t i = 0; i < output.features.size(); ++i) {
+            if (!listed(output.features[i].id)) {
+                if (kept != i) {
+                    output.features[kept] = std::move(output.features[i]);
+                    output_points[kept] = output_points[i];
+                }
+                ++kept;
+                continue;
+            }
+            output.num_points -= output_points[i];
+            if (sliced)
+                num_points -= output_points[i];
+            mapbox::geometry::for_each_point(output.features[i].geometry,
+                                             [&](const auto&) { --output.num_simplified; });
+            found = true;
+        }
+        output.features.erase(output.features.begin() + kept, output.features.end());
+        output_points.resize(kept);
+
+        return found;
+    }
+
+    // add features clipped to the tile: to its source features, unless it was sliced further, and
+    // to the output tile if it was built
+    void add(const vt_features& features) {
+        const bool sliced = source_features.empty() && num_points != 0;
+
+        for (const auto& feature : features) {
+            num_points += feature.num_points;
 
             bbox.min.x = std::min(feature.bbox.min.x, bbox.min.x);
             bbox.min.y = std::min(feature.bbox.min.y, bbox.min.y);
             bbox.max.x = std::max(feature.bbox.max.x, bbox.max.x);
             bbox.max.y = std::max(feature.bbox.max.y, bbox.max.y);
         }
+
+        if (!sliced)
+            source_features.insert(source_features.end(), features.begin(), features.end());
+        if (built.called())
+            build(features);
+    }
+
+    // the output tile if it was built already, null otherwise
+    const Tile* builtTile() const {
+        return built.called() ? &output : nullptr;
+    }
+
+    // the source points of each feature of the output tile, to save a tile that was sliced
+    // further together with its output tile
+    const std::vector<uint32_t>& outputPoints() const {
+        return output_points;
+    }
+
+    // set the output tile of a tile whose source features were dropped, as it was saved
+    void restore(Tile tile, std::vector<uint32_t> points) {
+        built.call([&] {
+            output = std::move(tile);
+            output_points = std::move(points);
+        });
     }
 
 private:
-    void addFeature(const vt_empty& empty, const property_map& props, const identifier& id) {
-        tile.features.push_back({ transform(empty), props, id });
+    mutable Tile output;
+    mutable once built;
+
+    // the source points of each output feature, counted on the first one made from each feature
+    mutable std::vector<uint32_t> output_points;
+
+    void build(const vt_features& source) const {
+#ifdef GEOJSONVT_OBSERVE
+        const stage_timer timer(observer, Stage::transform, z, x, y);
+        const size_t features = output.features.size();
+        const uint32_t simplified = output.num_simplified;
+#endif
+
+        for (const auto& feature : source) {
+            const auto& geom = *feature.geometry;
+            const auto& props = *feature.properties;
+            const auto& id = feature.id;
+            const size_t first = output.features.size();
+
+            output.num_points += feature.num_points;
+
+            vt_geometry::visit(geom, [&](const auto& g) {
+                // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
+                this->addFeature(g, props, id);
+            });
+
+            output_points.resize(output.features.size(), 0);
+            if (output.features.size() > first)
+                output_points[first] = feature.num_points;
+        }
+
+#ifdef GEOJSONVT_OBSERVE
+        timer.done(output.features.size() - features, output.num_simplified - simplified);
+#endif
+    }
+
+    void addFeature(const vt_empty& empty, const property_map& props, const identifier& id) const {
+        output.features.push_back({ transform(empty), props, id });
     }
 
     void
-    addFeature(const vt_point& point, const property_map& props, const identifier& id) {
-        tile.features.push_back({ transform(point), props, id });
+    addFeature(const vt_point& point, const property_map& props, const identifier& id) const {
+        output.features.push_back({ transform(point), props, id });
     }
 
     void addFeature(const vt_line_string& line,
                     const property_map& props,
-                    const identifier& id) {
+                    const identifier& id) const {
         const auto new_line = transform(line);
         if (!new_line.empty()) {
             if (lineMetrics) {
                 property_map newProps = props;
                 newProps["mapbox_clip_start"] = line.segStart / line.dist;
                 newProps["mapbox_clip_end"] = line.segEnd / line.dist;
-                tile.features.push_back({ std::move(new_line), newProps, id });
+                output.features.push_back({ std::move(new_line), newProps, id });
             } else
-                tile.features.push_back({ std::move(new_line), props, id });
+                output.features.push_back({ std::move(new_line), props, id });
         }
     }
 
     void addFeature(const vt_polygon& polygon,
                     const property_map& props,
-                    const identifier& id) {
+                    const identifier& id) const {
         const auto new_polygon = transform(polygon);
         if (!new_polygon.empty())
-            tile.features.push_back({ std::move(new_polygon), props, id });
+            output.features.push_back({ std::move(new_polygon), props, id });
     }
 
     void addFeature(const vt_geometry_collection& collection,
                     const property_map& props,
-                    const identifier& id) {
+                    const identifier& id) const {
         for (const auto& geom : collection) {
             vt_geometry::visit(geom, [&](const auto& g) {
                 // `this->` is a workaround for https://gcc.gnu.org/bugzilla/show_bug.cgi?id=61636
@@ -111,33 +242,69 @@ private:
         }
     }
 
+    void addFeature(const vt_flat_geometry& geom,
+                    const property_map& props,
+                    const identifier& id) const {
+        using shape = vt_flat_geometry::shape;
+
+        if (geom.type == shape::point) {
+            addMulti(transform(geom.points), props, id);
+
+        } else if (geom.type == shape::line) {
+            mapbox::geometry::multi_line_string<int16_t> lines;
+            for (size_t i = 0; i < geom.ends.size(); ++i) {
+                if (geom.measures[i] > tolerance)
+                    lines.push_back(transform<mapbox::geometry::line_string<int16_t>>(geom, i));
+            }
+            addMulti(std::move(lines), props, id);
+
+        } else {
+            mapbox::geometry::multi_polygon<int16_t> polygons;
+            size_t ring = 0;
+            for (const auto polygonEnd : geom.polygons) {
+                mapbox::geometry::polygon<int16_t> polygon;
+                for (; ring < polygonEnd; ++ring) {
+                    if (geom.measures[ring] > sq_tolerance)
+                        polygon.push_back(
+                            transform<mapbox::geometry::linear_ring<int16_t>>(geom, ring));
+                }
+                if (!polygon.empty())
+                    polygons.push_back(std::move(polygon));
+            }
+            addMulti(std::move(polygons), props, id);
+        }
+    }
+
     template <class T>
-    void addFeature(const T& multi, const property_map& props, const identifier& id) {
-        const auto new_multi = transform(multi);
+    void addFeature(const T& multi, const property_map& props, const identifier& id) const {
+        addMulti(transform(multi), props, id);
+    }
 
+    template <class T>
+    void addMulti(T&& new_multi, const property_map& props, const identifier& id) const {
         switch (new_multi.size()) {
         case 0:
             break;
         case 1:
-            tile.features.push_back({ std::move(new_multi[0]), props, id });
+            output.features.push_back({ std::move(new_multi[0]), props, id });
             break;
         default:
-            tile.features.push_back({ std::move(new_multi), props, id });
+            output.features.push_back({ std::move(new_multi), props, id });
             break;
         }
     }
 
-    mapbox::geometry::empty transform(const vt_empty& empty) {
+    mapbox::geometry::empty transform(const vt_empty& empty) const {
         return empty;
     }
 
-    mapbox::geometry::point<int16_t> transform(const vt_point& p) {
-        ++tile.num_simplified;
+    mapbox::geometry::point<int16_t> transform(const vt_point& p) const {
+        ++output.num_simplified;
         return { static_cast<int16_t>(::round((p.x * z2 - x) * extent)),
                  static_cast<int16_t>(::round((p.y * z2 - y) * extent)) };
     }
 
-    mapbox::geometry::multi_point<int16_t> transform(const vt_multi_point& points) {
+    mapbox::geometry::multi_point<int16_t> transform(const vt_multi_point& points) const {
         mapbox::geometry::multi_point<int16_t> result;
         result.reserve(points.size());
         for (const auto& p : points) {
@@ -146,7 +313,7 @@ private:
         return result;
     }
 
-    mapbox::geometry::line_string<int16_t> transform(const vt_line_string& line) {
+    mapbox::geometry::line_string<int16_t> transform(const vt_line_string& line) const {
         mapbox::geometry::line_string<int16_t> result;
         if (line.dist > tolerance) {
             for (const auto& p : line) {
@@ -157,7 +324,7 @@ private:
         return result;
     }
 
-    mapbox::geometry::linear_ring<int16_t> transform(const vt_linear_ring& ring) {
+    mapbox::geometry::linear_ring<int16_t> transform(const vt_linear_ring& ring) const {
         mapbox::geometry::linear_ring<int16_t> result;
         if (ring.area > sq_tolerance) {
             for (const auto& p : ring) {
@@ -168,7 +335,20 @@ private:
         return result;
     }
 
-    mapbox::geometry::multi_line_string<int16_t> transform(const vt_multi_line_string& lines) {
+    // a single line or ring of a flat geometry
+    template <class Part>
+    Part transform(const vt_flat_geometry& geom, const size_t part) const {
+        Part result;
+        for (size_t i = geom.partStart(part); i < geom.ends[part]; ++i) {
+            const auto& p = geom.points[i];
+            if (p.z > sq_tolerance)
+                result.push_back(transform(p));
+        }
+        return result;
+    }
+
+    mapbox::geometry::multi_line_string<int16_t>
+    transform(const vt_multi_line_string& lines) const {
         mapbox::geometry::multi_line_string<int16_t> result;
         for (const auto& line : lines) {
             if (line.dist > tolerance)
@@ -177,7 +357,7 @@ private:
         return result;
     }
 
-    mapbox::geometry::polygon<int16_t> transform(const vt_polygon& rings) {
+    mapbox::geometry::polygon<int16_t> transform(const vt_polygon& rings) const {
         mapbox::geometry::polygon<int16_t> result;
         for (const auto& ring : rings) {
             if (ring.area > sq_tolerance)
@@ -186,7 +366,7 @@ private:
         return result;
     }
 
-    mapbox::geometry::multi_polygon<int16_t> transform(const vt_multi_polygon& polygons) {
+    mapbox::geometry::multi_polygon<int16_t> transform(const vt_multi_polygon& polygons) const {
         mapbox::geometry::multi_polygon<int16_t> result;
         for (const auto& polygon : polygons) {
             const auto p = transform(polygon);
@@ -197,6 +377,95 @@ private:
     }
 };
 
+// the signed area of a ring whose points all lie on the edges of the given box, or 0 if any of them
+// is off the edges
+template <class Points>
+inline double edgeRingArea(const Points& points, const mapbox::geometry::box<double>& box) {
+    const double eps = 1e-9 * (box.max.x - box.min.x);
+    const auto onEdge = [&](const vt_point& p) {
+        return std::abs(p.x - box.min.x) < eps || std::abs(p.x - box.max.x) < eps ||
+               std::abs(p.y - box.min.y) < eps || std::abs(p.y - box.max.y) < eps;
+    };
+
+    double area = 0;
+    for (size_t i = 0; i + 1 < points.size(); ++i) {
+        const auto& a = points[i];
+        const auto& b = points[i + 1];
+        if (!onEdge(a))
+            return 0;
+        area += a.x * b.y - b.x * a.y;
+    }
+    return area / 2;
+}
+
+// the signed area of the single ring of a polygon feature if it lies along the edges of the box,
+// or 0 for anything else
+struct edge_polygon_area {
+    const mapbox::geometry::box<double>& box;
+
+    template <class T>
+    double operator()(const T&) const {
+        return 0;
+    }
+
+    double operator()(const vt_polygon& polygon) const {
+        return polygon.size() == 1 ? edgeRingArea(polygon[0], box) : 0;
+    }
+
+    double operator()(const vt_multi_polygon& polygons) const {
+        return polygons.size() == 1 ? operator()(polygons[0]) : 0;
+    }
+
+    double operator()(const vt_flat_geometry& geom) const {
+        if (geom.type != vt_flat_geometry::shape::polygon || geom.ends.size() != 1)
+            return 0;
+        return edgeRingArea(geom.points, box);
+    }
+};
+
+/* Clipping a polygon that covers a whole tile leaves just the tile's buffered square, and the same
+ * square in every tile under it. If every one of the features of tile z/x/y is such a square, this
+ * returns the output tile that all of the tiles under it share: one square per feature, wound the
+ * same way as the feature. Otherwise it returns null.
+ */
+inline std::shared_ptr<const Tile> coveredTile(const vt_features& features,
+                                               const uint8_t z,
+                                               const uint32_t x,
+                                               const uint32_t y,
+                                               const uint16_t extent,
+                                               const uint16_t buffer) {
+    if (features.empty())
+        return nullptr;
+
+    const double z2 = 1u << z;
+    const double p = double(buffer) / extent;
+    const mapbox::geometry::box<double> box{ { (x - p) / z2, (y - p) / z2 },
+                                             { (x + 1 + p) / z2, (y + 1 + p) / z2 } };
+    const double boxArea = (box.max.x - box.min.x) * (box.max.y - box.min.y);
+
+    const int16_t min = -static_cast<int16_t>(buffer);
+    const int16_t max = static_cast<int16_t>(extent + buffer);
+    auto tile = std::make_shared<Tile>();
+
+    for (const auto& feature : features) {
+        const double area = vt_geometry::visit(*feature.geometry, edge_polygon_area{ box });
+        if (std::abs(std::abs(area) - boxArea) > 1e-6 * boxArea)
+            return nullptr;
+
+        mapbox::geometry::linear_ring<int16_t> ring{ { min, min }, { max, min }, { max, max },
+                                                     { min, max }, { min, min } };
+        if (area < 0)
+            std::reverse(ring.begin(), ring.end());
+
+        tile->num_points += ring.size();
+        tile->num_simplified += ring.size();
+        tile->features.push_back(
+            { mapbox::geometry::polygon<int16_t>{ std::move(ring) }, *feature.properties, feature.id });
+    }
+
+    return tile;
+}
+
 } // namespace detail
 } // namespace geojsonvt
 } // namespace mapbox
@@ -0,0 +1,640 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace mapbox {
+namespace geojsonvt {
+namespace detail {
+
+// deepest zoom the Z-order key below can represent
+constexpr uint8_t z_order_max_zoom = 29;
+
+// spread the lower 29 bits of v out to the even bits of the result
+inline uint64_t interleaveBits(const uint32_t v) {
+    uint64_t x = v & 0x1FFFFFFFull;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+// gather the even bits of v into the lower 32 bits of the result, undoing interleaveBits
+inline uint32_t compactBits(uint64_t v) {
+    v &= 0x5555555555555555ull;
+    v = (v | (v >> 1)) & 0x3333333333333333ull;
+    v = (v | (v >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+    v = (v | (v >> 4)) & 0x00FF00FF00FF00FFull;
+    v = (v | (v >> 8)) & 0x0000FFFF0000FFFFull;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFFull;
+    return static_cast<uint32_t>(v);
+}
+
+/* A key that orders tiles along a Z-order (Morton) curve: the coordinates of the tile's top-left
+ * corner at z_order_max_zoom are interleaved, with the zoom in the low 5 bits. Every tile sorts
+ * just before its descendants, and a tile together with everything under it forms one contiguous
+ * range of keys, from zOrderKey(z, x, y) up to (but excluding) zOrderEnd(z, x, y).
+ */
+inline uint64_t zOrderKey(const uint8_t z, const uint32_t x, const uint32_t y) {
+    const uint8_t shift = z_order_max_zoom - z;
+    const uint64_t corner = interleaveBits(x << shift) | (interleaveBits(y << shift) << 1);
+    return (corner << 5) | z;
+}
+
+inline uint64_t zOrderEnd(const uint8_t z, const uint32_t x, const uint32_t y) {
+    const uint8_t shift = z_order_max_zoom - z;
+    const uint64_t corner = interleaveBits(x << shift) | (interleaveBits(y << shift) << 1);
+    return (corner + (1ull << (2 * shift))) << 5;
+}
+
+// the zoom and coordinates of the tile with the given Z-order key
+inline std::tuple<uint8_t, uint32_t, uint32_t> fromZOrderKey(const uint64_t key) {
+    const uint8_t z = key & 31;
+    const uint8_t shift = z_order_max_zoom - z;
+    const uint64_t corner = key >> 5;
+    return std::make_tuple(z, compactBits(corner) >> shift, compactBits(corner >> 1) >> shift);
+}
+
+// the zoom and coordinates of a tile id as made by toID
+inline std::tuple<uint8_t, uint32_t, uint32_t> fromID(const uint64_t id) {
+    const uint8_t z = id & 31;
+    const uint64_t n = id >> 5;
+    return std::make_tuple(z, static_cast<uint32_t>(n & ((1ull << z) - 1)),
+                           static_cast<uint32_t>(n >> z));
+}
+
+// the Z-order key of a tile id as made by toID
+inline uint64_t zOrderKey(const uint64_t id) {
+    uint8_t z;
+    uint32_t x;
+    uint32_t y;
+    std::tie(z, x, y) = fromID(id);
+    return zOrderKey(z, x, y);
+}
+
+// whether any of the given sorted Z-order keys is one of a tile strictly under tile z/x/y
+inline bool anyBelow(const std::vector<uint64_t>& keys,
+                     const uint8_t z,
+                     const uint32_t x,
+                     const uint32_t y) {
+    const auto it = std::upper_bound(keys.begin(), keys.end(), zOrderKey(z, x, y));
+    return it != keys.end() && *it < zOrderEnd(z, x, y);
+}
+
+// whether any of the given sorted Z-order keys is one of tile z/x/y or a tile under it
+inline bool anyWithin(const std::vector<uint64_t>& keys,
+                      const uint8_t z,
+                      const uint32_t x,
+                      const uint32_t y) {
+    const auto it = std::lower_bound(keys.begin(), keys.end(), zOrderKey(z, x, y));
+    return it != keys.end() && *it < zOrderEnd(z, x, y);
+}
+
+/* An open-addressing hash map from tile ids to tiles. Ids are kept next to each other in a single
+ * array that is probed linearly, so a lookup (including every step of a parent search) usually
+ * touches one cache line and never follows a chain of nodes. Tiles themselves are allocated one
+ * by one, so references to them stay valid while the map grows.
+ *
+ * Keys must be tile ids made by toID. Next to the hash table the map keeps an index of its tiles
+ * in Z-order, which turns "everything under this tile" and "everything in this range at zoom z"
+ * into range scans. The index is sorted lazily, on the first such query after tiles were added or
+ * removed, so building the map doesn't pay for it.
+ */
+
+template <class T>
+class tile_map {
+public:
+    using key_type = uint64_t;
+    using mapped_type = T;
+    using value_type = std::pair<const uint64_t, T>;
+
+private:
+    struct slot {
+        uint64_t id = 0;
+        value_type* value = nullptr; // null for empty slots
+    };
+
+    template <bool Const>
+    class basic_iterator {
+        using slot_pointer = std::conditional_t<Const, const slot*, slot*>;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = tile_map::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+        basic_iterator() = default;
+
+        // iterator converts to const_iterator
+        template <bool C, class = std::enable_if_t<Const && !C>>
+        basic_iterator(const basic_iterator<C>& other) : current(other.current), last(other.last) {
+        }
+
+        reference operator*() const {
+            return *current->value;
+        }
+
+        pointer operator->() const {
+            return current->value;
+        }
+
+        basic_iterator& operator++() {
+            ++current;
+            skip();
+            return *this;
+        }
+
+        basic_iterator operator++(int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const basic_iterator& other) const {
+            return current == other.current;
+        }
+
+        bool operator!=(const basic_iterator& other) const {
+            return current != other.current;
+        }
+
+    private:
+        friend class tile_map;
+        template <bool>
+        friend class basic_iterator;
+
+        basic_iterator(slot_pointer current_, slot_pointer last_) : current(current_), last(last_) {
+            skip();
+        }
+
+        void skip() {
+            while (current != last && !current->value)
+                ++current;
+        }
+
+        slot_pointer current = nullptr;
+        slot_pointer last = nullptr;
+    };
+
+public:
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    tile_map() = default;
+
+    tile_map(const tile_map& other) {
+        reserve(other.used);
+        for (const auto& pair : other) {
+            insert(pair.first, new value_type(pair));
+        }
+    }
+
+    tile_map(tile_map&& other) noexcept
+        : slots(std::move(other.slots)),
+          used(other.used),
+          order(std::move(other.order)),
+          sorted(other.sorted),
+          stale(other.stale) {
+        other.slots.clear();
+        other.used = 0;
+        other.order.clear();
+        other.sorted = 0;
+    }
+
+    tile_map& operator=(tile_map other) noexcept {
+        std::swap(slots, other.slots);
+        std::swap(used, other.used);
+        std::swap(order, other.order);
+        std::swap(sorted, other.sorted);
+        std::swap(stale, other.stale);
+        return *this;
+    }
+
+    ~tile_map() {
+        clear();
+    }
+
+    size_t size() const {
+        return used;
+    }
+
+    bool empty() const {
+        return used == 0;
+    }
+
+    iterator begin() {
+        return { slots.data(), slots.data() + slots.size() };
+    }
+
+    iterator end() {
+        return { slots.data() + slots.size(), slots.data() + slots.size() };
+    }
+
+    const_iterator begin() const {
+        return { slots.data(), slots.data() + slots.size() };
+    }
+
+    const_iterator end() const {
+        return { slots.data() + slots.size(), slots.data() + slots.size() };
+    }
+
+    iterator find(const uint64_t id) {
+        const slot* s = lookup(id);
+        return s ? iterator(slots.data() + (s - slots.data()), slots.data() + slots.size()) : end();
+    }
+
+    const_iterator find(const uint64_t id) const {
+        const slot* s = lookup(id);
+        return s ? const_iterator(s, slots.data() + slots.size()) : end();
+    }
+
+    size_t count(const uint64_t id) const {
+        return lookup(id) ? 1 : 0;
+    }
+
+    template <class... Args>
+    std::pair<iterator, bool> emplace(const uint64_t id, Args&&... args) {
+        auto it = find(id);
+        if (it != end())
+            return { it, false };
+
+        reserve(used + 1);
+        auto* value = new value_type(std::piecewise_construct, std::forward_as_tuple(id),
+                                     std::forward_as_tuple(std::forward<Args>(args)...));
+        return { insert(id, value), true };
+    }
+
+    size_t erase(const uint64_t id) {
+        slot* s = const_cast<slot*>(lookup(id));
+        if (!s)
+            return 0;
+
+        delete s->value;
+        s->value = nullptr;
+        --used;
+        stale = true;
+
+        // shift back the entries that follow in the same run, so that probing never has to skip
+        // over deleted slots
+        const size_t mask = slots.size() - 1;
+        size_t hole = static_cast<size_t>(s - slots.data());
+        for (size_t i = (hole + 1) & mask; slots[i].value; i = (i + 1) & mask) {
+            const size_t home = hash(slots[i].id) & mask;
+            // move the entry into the hole unless its home lies cyclically within (hole, i]
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                slots[hole] = slots[i];
+                slots[i].value = nullptr;
+                hole = i;
+            }
+        }
+        return 1;
+    }
+
+    // moves all tiles of another map into this one without copying them; tiles already present
+    // are kept
+    void merge(tile_map&& other) {
+        reserve(used + other.used);
+        for (auto& s : other.slots) {
+            if (!s.value)
+                continue;
+            if (lookup(s.id))
+                delete s.value;
+            else
+                insert(s.id, s.value);
+        }
+        other.slots.clear();
+        other.used = 0;
+        other.order.clear();
+        other.sorted = 0;
+    }
+
+    void clear() {
+        for (auto& s : slots) {
+            delete s.value;
+            s.value = nullptr;
+        }
+        used = 0;
+        order.clear();
+        sorted = 0;
+        stale = false;
+    }
+
+    // bytes taken by the hash table and the Z-order index, not counting the tiles themselves
+    size_t tableBytes() const {
+        return slots.capacity() * sizeof(slot) + order.capacity() * sizeof(entry);
+    }
+
+    // makes room for n tiles without growing the slot array again
+    void reserve(const size_t n) {
+        if (n * 2 <= slots.size())
+            return;
+
+        size_t capacity = 16;
+        while (capacity < n * 2)
+            capacity *= 2;
+
+        std::vector<slot> old(capacity);
+        std::swap(old, slots);
+        used = 0;
+        for (const auto& s : old) {
+            if (s.value)
+                place(s.id, s.value);
+        }
+    }
+
+    // calls f with the tile z/x/y, if present, and every tile under it, in Z-order
+    template <class F>
+    void eachDescendant(const uint8_t z, const uint32_t x, const uint32_t y, F&& f) const {
+        sortOrder();
+        const auto last = order.end();
+        const auto before = [](const entry& e, const uint64_t key) { return e.first < key; };
+        auto it = std::lower_bound(order.begin(), last, zOrderKey(z, x, y), before);
+        for (const uint64_t end = zOrderEnd(z, x, y); it != last && it->first < end; ++it) {
+            f(*it->second);
+        }
+    }
+
+    // calls f with every tile at zoom z within [minX, maxX] x [minY, maxY], in Z-order
+    template <class F>
+    void eachInRange(const uint8_t z,
+                     const uint32_t minX,
+                     const uint32_t minY,
+                     const uint32_t maxX,
+                     const uint32_t maxY,
+                     F&& f) const {
+        if (minX > maxX || minY > maxY)
+            return;
+
+        // scan the (at most 2x2) ancestors of the range at the deepest zoom where they cover it
+        uint8_t k = 0;
+        while (k < z && ((maxX >> k) - (minX >> k) > 1 || (maxY >> k) - (minY >> k) > 1))
+            ++k;
+
+        for (uint32_t ay = minY >> k; ay <= maxY >> k; ++ay) {
+            for (uint32_t ax = minX >> k; ax <= maxX >> k; ++ax) {
+                eachDescendant(z - k, ax, ay, [&](const value_type& pair) {
+                    const uint64_t n = pair.first >> 5;
+                    const uint32_t x = static_cast<uint32_t>(n & ((1ull << z) - 1));
+                    const uint32_t y = static_cast<uint32_t>(n >> z);
+                    if ((pair.first & 31) == z && x >= minX && x <= maxX && y >= minY && y <= maxY)
+                        f(pair);
+                });
+            }
+        }
+    }
+
+private:
+    using entry = std::pair<uint64_t, const value_type*>;
+
+    std::vector<slot> slots; // a power of two in size, and never more than half full
+    size_t used = 0;
+
+    // Z-order keys of all tiles; the first `sorted` entries are in order, the rest were added
+    // since the last query, and a removal marks the whole index stale
+    mutable std::vector<entry> order;
+    mutable size_t sorted = 0;
+    mutable bool stale = false;
+
+    void sortOrder() const {
+        const auto byKey = [](const entry& a, const entry& b) { return a.first < b.first; };
+
+        if (stale) {
+            order.clear();
+            for (const auto& s : slots) {
+                if (s.value)
+                    order.emplace_back(zOrderKey(s.id), s.value);
+            }
+            sorted = 0;
+            stale = false;
+        }
+
+        if (sorted < order.size()) {
+            std::sort(order.begin() + sorted, order.end(), byKey);
+            std::inplace_merge(order.begin(), order.begin() + sorted, order.end(), byKey);
+            sorted = order.size();
+        }
+    }
+
+    // add a tile to both the hash table and the Z-order index
+    iterator insert(const uint64_t id, value_type* value) {
+        if (!stale)
+            order.emplace_back(zOrderKey(id), value);
+        return place(id, value);
+    }
+
+    static size_t hash(const uint64_t id) {
+        const uint64_t h = id * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    const slot* lookup(const uint64_t id) const {
+        if (used == 0)
+            return nullptr;
+
+        const size_t mask = slots.size() - 1;
+        for (size_t i = hash(id) & mask;; i = (i + 1) & mask) {
+            const slot& s = slots[i];
+            if (!s.value)
+                return nullptr;
+            if (s.id == id)
+                return &s;
+        }
+    }
+
+    // insert a tile known to be missing, with room already reserved
+    iterator place(const uint64_t id, value_type* value) {
+        const size_t mask = slots.size() - 1;
+        size_t i = hash(id) & mask;
+        while (slots[i].value)
+            i = (i + 1) & mask;
+
+        slots[i].id = id;
+        slots[i].value = value;
+        ++used;
+        return { slots.data() + i, slots.data() + slots.size() };
+    }
+};
+
+/* Ids of tiles that may be evicted, picked with the CLOCK (second chance) approximation of least
+ * recently used: every tile has a reference bit that readers set with use(), without any lock but
+ * the shared one on the index, and pop goes around the tiles from the oldest one, clearing the bits
+ * it finds set and moving those tiles to the back, until it finds one that wasn't used since.
+ */
+class tile_lru {
+public:
+    tile_lru() = default;
+
+    tile_lru(const tile_lru& other) {
+        for (const auto& e : other.order) {
+            positions.emplace(e.id, order.emplace(order.end(), e.id, e.used.load()));
+        }
+    }
+
+    tile_lru(tile_lru&&) = default;
+
+    tile_lru& operator=(tile_lru other) {
+        std::swap(order, other.order);
+        std::swap(positions, other.positions);
+        return *this;
+    }
+
+    size_t size() const {
+        return order.size();
+    }
+
+    // add a tile, or mark it as used; needs exclusive access
+    void touch(const uint64_t id) {
+        const auto it = positions.find(id);
+        if (it != positions.end())
+            it->second->used.store(true, std::memory_order_relaxed);
+        else
+            positions.emplace(id, order.emplace(order.end(), id, false));
+    }
+
+    // mark a tile as used; safe to call from several threads at once, as long as none of them
+    // adds or removes tiles meanwhile
+    void use(const uint64_t id) const {
+        const auto it = positions.find(id);
+        if (it != positions.end() && !it->second->used.load(std::memory_order_relaxed))
+            it->second->used.store(true, std::memory_order_relaxed);
+    }
+
+    void erase(const uint64_t id) {
+        const auto it = positions.find(id);
+        if (it != positions.end()) {
+            order.erase(it->second);
+            positions.erase(it);
+        }
+    }
+
+    // remove and return the oldest tile not used since the last time pop went past it
+    uint64_t pop() {
+        while (order.front().used.load(std::memory_order_relaxed)) {
+            order.front().used.store(false, std::memory_order_relaxed);
+            order.splice(order.end(), order, order.begin());
+        }
+        const uint64_t id = order.front().id;
+        positions.erase(id);
+        order.pop_front();
+        return id;
+    }
+
+private:
+    struct entry {
+        entry(const uint64_t id_, const bool used_) : id(id_), used(used_) {
+        }
+
+        uint64_t id;
+        mutable std::atomic<bool> used;
+    };
+
+    std::list<entry> order;
+    std::unordered_map<uint64_t, std::list<entry>::iterator> positions;
+};
+
+/* A set of whole subtrees of tiles, each kept as the range of Z-order keys it covers, sorted in one
+ * array, with a value for each. Two subtrees are either nested or disjoint, and adding one drops
+ * the ranges under it, so the ranges never overlap: finding the subtree a tile lies in is a single
+ * binary search, however deep under the subtree's root the tile is.
+ */
+template <class T = bool>
+class tile_ranges {
+public:
+    size_t size() const {
+        return ranges.size();
+    }
+
+    // the value of the subtree tile z/x/y lies in, or null if it lies in none
+    const T* find(const uint8_t z, const uint32_t x, const uint32_t y) const {
+        return find(zOrderKey(z, x, y));
+    }
+
+    bool contains(const uint8_t z, const uint32_t x, const uint32_t y) const {
+        return find(z, x, y) != nullptr;
+    }
+
+    // add tile z/x/y and everything under it
+    void insert(const uint8_t z, const uint32_t x, const uint32_t y, T value = {}) {
+        insert({ zOrderKey(z, x, y), zOrderEnd(z, x, y), std::move(value) });
+    }
+
+    // remove every subtree that tile z/x/y lies in or that lies under it
+    void erase(const uint8_t z, const uint32_t x, const uint32_t y) {
+        const uint64_t begin = zOrderKey(z, x, y);
+        const uint64_t end = zOrderEnd(z, x, y);
+        const auto below = [](const range& a, const uint64_t k) { return a.begin < k; };
+        auto first = std::lower_bound(ranges.begin(), ranges.end(), begin, below);
+        if (first != ranges.begin() && std::prev(first)->end > begin)
+            --first;
+        const auto last = std::lower_bound(first, ranges.end(), end, below);
+        ranges.erase(first, last);
+    }
+
+    // add the subtrees of another set
+    void merge(const tile_ranges& other) {
+        for (const auto& r : other.ranges) {
+            insert(r);
+        }
+    }
+
+    void clear() {
+        ranges.clear();
+    }
+
+    size_t bytes() const {
+        return ranges.capacity() * sizeof(range);
+    }
+
+    // calls f(z, x, y, value) with the top tile of every subtree, in Z-order
+    template <class F>
+    void each(F&& f) const {
+        for (const auto& r : ranges) {
+            const auto tile = fromZOrderKey(r.begin);
+            f(std::get<0>(tile), std::get<1>(tile), std::get<2>(tile), r.value);
+        }
+    }
+
+private:
+    struct range {
+        uint64_t begin;
+        uint64_t end;
+        T value;
+    };
+
+    std::vector<range> ranges;
+
+    const T* find(const uint64_t key) const {
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), key,
+                                   [](const uint64_t k, const range& r) { return k < r.begin; });
+        if (it == ranges.begin() || key >= (--it)->end)
+            return nullptr;
+        return &it->value;
+    }
+
+    void insert(range r) {
+        if (find(r.begin))
+            return;
+
+        const auto below = [](const range& a, const uint64_t k) { return a.begin < k; };
+        const auto first = std::lower_bound(ranges.begin(), ranges.end(), r.begin, below);
+        const auto last = std::lower_bound(first, ranges.end(), r.end, below);
+        ranges.insert(ranges.erase(first, last), std::move(r));
+    }
+};
+
+} // namespace detail
+} // namespace geojsonvt
+} // namespace mapbox
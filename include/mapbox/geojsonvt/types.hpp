@@ -1,20 +1,106 @@
 #pragma once
 
+#include <mapbox/geojsonvt/allocator.hpp>
 #include <mapbox/geometry.hpp>
 #include <mapbox/feature.hpp>
 #include <mapbox/variant.hpp>
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+// define GEOJSONVT_COMPACT_POINTS to store vt_point coordinates in fixed point, for half the memory
+// per point; the coordinates then only resolve one unit of a 4096 extent tile at z18, and indexes
+// with a finer extent at maxZoom can't be built
+
+// allocator template for all geometry containers; define it as another allocator (for example
+// mapbox::geojsonvt::detail::pool_allocator) before including geojson-vt to change it; it changes
+// the types of the containers, so every translation unit of a program that includes geojson-vt
+// must define it the same way (best on the command line), or the program breaks the one
+// definition rule without any diagnostic
+#ifndef GEOJSONVT_ALLOCATOR
+#define GEOJSONVT_ALLOCATOR std::allocator
+#endif
+
 namespace mapbox {
 namespace geojsonvt {
 namespace detail {
 
+template <class T>
+using vt_allocator = GEOJSONVT_ALLOCATOR<T>;
+
+template <class T>
+using vt_vector = std::vector<T, vt_allocator<T>>;
+
+// allocates an immutable object shared between features with vt_allocator
+template <class T, class... Args>
+inline std::shared_ptr<const T> makeShared(Args&&... args) {
+    return std::allocate_shared<const T>(vt_allocator<T>(), std::forward<Args>(args)...);
+}
+
 using vt_empty = mapbox::geometry::empty;
 
+// a projected coordinate stored as a 32-bit fixed-point number with a resolution of 2^-30, which is
+// one unit of a 4096 extent tile at z18; covers [-2, 2), i.e. longitudes within (-900, 540)
+class vt_fixed {
+public:
+    static constexpr uint8_t fraction_bits = 30;
+
+    vt_fixed(const double value) : raw(encode(value)) {
+    }
+
+    operator double() const {
+        return raw / scale();
+    }
+
+    vt_fixed& operator+=(const double offset) {
+        raw = encode(double(*this) + offset);
+        return *this;
+    }
+
+private:
+    static constexpr double scale() {
+        return 1 << fraction_bits;
+    }
+
+    static int32_t encode(const double value) {
+        const double scaled = std::floor(value * scale() + 0.5);
+        return static_cast<int32_t>(std::max(std::min(scaled, 2147483647.0), -2147483648.0));
+    }
+
+    int32_t raw;
+};
+
+#ifdef GEOJSONVT_COMPACT_POINTS
+
+// 12 bytes instead of 24: fixed-point coordinates and a single-precision importance
+struct vt_point {
+    vt_fixed x;
+    vt_fixed y;
+    float z = 0.0f; // simplification tolerance
+
+    vt_point(double x_, double y_, double z_) : x(x_), y(y_), z(static_cast<float>(z_)) {
+    }
+
+    vt_point(double x_, double y_) : vt_point(x_, y_, 0.0) {
+    }
+};
+
+inline bool operator==(const vt_point& a, const vt_point& b) {
+    return double(a.x) == double(b.x) && double(a.y) == double(b.y);
+}
+
+inline bool operator!=(const vt_point& a, const vt_point& b) {
+    return !(a == b);
+}
+
+#else
+
 struct vt_point : mapbox::geometry::point<double> {
     double z = 0.0; // simplification tolerance
 
@@ -25,6 +111,8 @@ struct vt_point : mapbox::geometry::point<double> {
     }
 };
 
+#endif
+
 template <uint8_t I, typename T>
 inline double get(const T&);
 
@@ -72,10 +160,10 @@ inline vt_point intersect<1>(const vt_point& a, const vt_point& b, const double
     return { x, y, 1.0 };
 }
 
-using vt_multi_point = std::vector<vt_point>;
+using vt_multi_point = vt_vector<vt_point>;
 
-struct vt_line_string : std::vector<vt_point> {
-    using container_type = std::vector<vt_point>;
+struct vt_line_string : vt_vector<vt_point> {
+    using container_type = vt_vector<vt_point>;
     vt_line_string() = default;
     vt_line_string(std::initializer_list<vt_point> args)
       : container_type(std::move(args)) {}
@@ -85,8 +173,8 @@ struct vt_line_string : std::vector<vt_point> {
     double segEnd = 0.0; // segStart and segEnd are distance along a line in tile units, when lineMetrics = true
 };
 
-struct vt_linear_ring : std::vector<vt_point> {
-    using container_type = std::vector<vt_point>;
+struct vt_linear_ring : vt_vector<vt_point> {
+    using container_type = vt_vector<vt_point>;
     vt_linear_ring() = default;
     vt_linear_ring(std::initializer_list<vt_point> args)
       : container_type(std::move(args)) {}
@@ -94,9 +182,66 @@ struct vt_linear_ring : std::vector<vt_point> {
     double area = 0.0; // polygon ring area
 };
 
-using vt_multi_line_string = std::vector<vt_line_string>;
-using vt_polygon = std::vector<vt_linear_ring>;
-using vt_multi_polygon = std::vector<vt_polygon>;
+using vt_multi_line_string = vt_vector<vt_line_string>;
+using vt_polygon = vt_vector<vt_linear_ring>;
+using vt_multi_polygon = vt_vector<vt_polygon>;
+
+// a flat alternative to the nested (multi) point, line and polygon types above: all points of a
+// feature in one array, plus the end offsets of every line or ring and of every polygon
+struct vt_flat_geometry {
+    enum class shape : uint8_t { point, line, polygon };
+
+    shape type = shape::point;
+    vt_vector<vt_point> points;
+    vt_vector<uint32_t> ends;     // one past the last point of each line or ring
+    vt_vector<double> measures;   // length of each line or area of each ring
+    vt_vector<uint32_t> polygons; // one past the last ring of each polygon
+
+    explicit vt_flat_geometry(const shape type_ = shape::point) : type(type_) {
+    }
+
+    // index of the first point of the given line or ring
+    size_t partStart(const size_t part) const {
+        return part == 0 ? 0 : ends[part - 1];
+    }
+
+    // close the line or ring started at the given point, if it got any points
+    void endPart(const size_t start, const double measure) {
+        if (points.size() > start) {
+            ends.push_back(static_cast<uint32_t>(points.size()));
+            measures.push_back(measure);
+        }
+    }
+
+    // close the polygon started at the given ring, if it got any rings
+    void endPolygon(const size_t start) {
+        if (ends.size() > start)
+            polygons.push_back(static_cast<uint32_t>(ends.size()));
+    }
+
+    // iterating a flat geometry visits its points, so that for_each_point works on it
+    auto begin() {
+        return points.begin();
+    }
+    auto end() {
+        return points.end();
+    }
+    auto begin() const {
+        return points.begin();
+    }
+    auto end() const {
+        return points.end();
+    }
+};
+
+inline bool operator==(const vt_flat_geometry& a, const vt_flat_geometry& b) {
+    return a.type == b.type && a.points == b.points && a.ends == b.ends &&
+           a.measures == b.measures && a.polygons == b.polygons;
+}
+
+inline bool operator!=(const vt_flat_geometry& a, const vt_flat_geometry& b) {
+    return !(a == b);
+}
 
 struct vt_geometry_collection;
 
@@ -107,9 +252,10 @@ using vt_geometry = mapbox::util::variant<vt_empty,
                                           vt_multi_point,
                                           vt_multi_line_string,
                                           vt_multi_polygon,
-                                          vt_geometry_collection>;
+                                          vt_geometry_collection,
+                                          vt_flat_geometry>;
 
-struct vt_geometry_collection : std::vector<vt_geometry> {};
+struct vt_geometry_collection : vt_vector<vt_geometry> {};
 
 using null_value = mapbox::feature::null_value_t;
 using property_map = mapbox::feature::property_map;
@@ -156,27 +302,41 @@ struct vt_geometry_type<geometry::geometry_collection<double>> {
 };
 
 struct vt_feature {
-    vt_geometry geometry;
-    property_map properties;
+    // geometry and properties are never modified once built, so they are shared by all tiles
+    // the feature ends up in; only cut geometry gets copied
+    std::shared_ptr<const vt_geometry> geometry;
+    std::shared_ptr<const property_map> properties;
     identifier id;
 
     mapbox::geometry::box<double> bbox = { { 2, 1 }, { -1, 0 } };
     uint32_t num_points = 0;
 
-    vt_feature(const vt_geometry& geom, const property_map& props, const identifier& id_)
-        : geometry(geom), properties(props), id(id_) {
+    vt_feature(std::shared_ptr<const vt_geometry> geom,
+               const std::shared_ptr<const property_map>& props,
+               const identifier& id_)
+        : geometry(std::move(geom)), properties(props), id(id_) {
 
-        mapbox::geometry::for_each_point(geom, [&](const vt_point& p) {
-            bbox.min.x = std::min(p.x, bbox.min.x);
-            bbox.min.y = std::min(p.y, bbox.min.y);
-            bbox.max.x = std::max(p.x, bbox.max.x);
-            bbox.max.y = std::max(p.y, bbox.max.y);
+        mapbox::geometry::for_each_point(*geometry, [&](const vt_point& p) {
+            bbox.min.x = std::min<double>(p.x, bbox.min.x);
+            bbox.min.y = std::min<double>(p.y, bbox.min.y);
+            bbox.max.x = std::max<double>(p.x, bbox.max.x);
+            bbox.max.y = std::max<double>(p.y, bbox.max.y);
             ++num_points;
         });
     }
+
+    vt_feature(const vt_geometry& geom, const std::shared_ptr<const property_map>& props,
+               const identifier& id_)
+        : vt_feature(makeShared<vt_geometry>(geom), props, id_) {
+    }
+
+    vt_feature(vt_geometry&& geom, const std::shared_ptr<const property_map>& props,
+               const identifier& id_)
+        : vt_feature(makeShared<vt_geometry>(std::move(geom)), props, id_) {
+    }
 };
 
-using vt_features = std::vector<vt_feature>;
+using vt_features = vt_vector<vt_feature>;
 
 } // namespace detail
 } // namespace geojsonvt
@@ -3,20 +3,25 @@
 #include <mapbox/geojsonvt/clip.hpp>
 #include <mapbox/geojsonvt/types.hpp>
 
+#include <iterator>
+#include <memory>
+
 namespace mapbox {
 namespace geojsonvt {
 namespace detail {
 
 inline void shiftCoords(vt_features& features, double offset) {
     for (auto& feature : features) {
-        mapbox::geometry::for_each_point(feature.geometry,
+        auto geometry = *feature.geometry;
+        mapbox::geometry::for_each_point(geometry,
                                          [offset](vt_point& point) { point.x += offset; });
+        feature.geometry = makeShared<vt_geometry>(std::move(geometry));
         feature.bbox.min.x += offset;
         feature.bbox.max.x += offset;
     }
 }
 
-inline vt_features wrap(const vt_features& features, double buffer, const bool lineMetrics) {
+inline vt_features wrap(vt_features features, double buffer, const bool lineMetrics) {
     // left world copy
     auto left = clip<0>(features, -1 - buffer, buffer, -1, 2, lineMetrics);
     // right world copy
@@ -26,17 +31,19 @@ inline vt_features wrap(const vt_features& features, double buffer, const bool l
         return features;
 
     // center world copy
-    auto merged = clip<0>(features, -buffer, 1 + buffer, -1, 2, lineMetrics);
+    auto merged = clip<0>(std::move(features), -buffer, 1 + buffer, -1, 2, lineMetrics);
 
     if (!left.empty()) {
         // merge left into center
         shiftCoords(left, 1.0);
-        merged.insert(merged.begin(), left.begin(), left.end());
+        merged.insert(merged.begin(), std::make_move_iterator(left.begin()),
+                      std::make_move_iterator(left.end()));
     }
     if (!right.empty()) {
         // merge right into center
         shiftCoords(right, -1.0);
-        merged.insert(merged.end(), right.begin(), right.end());
+        merged.insert(merged.end(), std::make_move_iterator(right.begin()),
+                      std::make_move_iterator(right.end()));
     }
     return merged;
 }
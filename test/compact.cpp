@@ -0,0 +1,79 @@
+// built with GEOJSONVT_COMPACT_POINTS defined, which changes vt_point, so apart from other tests
+#include "util.hpp"
+#include <gtest/gtest.h>
+#include <mapbox/geojson.hpp>
+#include <mapbox/geojson_impl.hpp>
+#include <mapbox/geojsonvt.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace mapbox::geojsonvt;
+
+GTEST_API_ int main(int argc, char* argv[]) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+std::vector<mapbox::geometry::point<int16_t>>
+points(const mapbox::feature::feature<int16_t>& feature) {
+    std::vector<mapbox::geometry::point<int16_t>> result;
+    mapbox::geometry::for_each_point(
+        feature.geometry, [&](const mapbox::geometry::point<int16_t>& p) { result.push_back(p); });
+    return result;
+}
+
+// the same features as the tiles the default build made, with every coordinate within one unit
+void expectWithinOneUnit(const mapbox::feature::feature_collection<int16_t>& expected,
+                         const mapbox::feature::feature_collection<int16_t>& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQ(expected[i].id == actual[i].id, true);
+        const auto a = points(expected[i]);
+        const auto b = points(actual[i]);
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t j = 0; j < a.size(); ++j) {
+            ASSERT_LE(std::abs(a[j].x - b[j].x), 1);
+            ASSERT_LE(std::abs(a[j].y - b[j].y), 1);
+        }
+    }
+}
+
+TEST(CompactPoints, MatchDefaultBuild) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT index{ geojson };
+
+    // tiles on the way down to two points on state borders, as the default build makes them
+    const auto expected = parseJSONTiles(loadFile("test/fixtures/us-states-path-tiles.json"));
+    ASSERT_EQ(expected.size(), 20u);
+    for (const auto& pair : expected) {
+        unsigned z;
+        unsigned x;
+        unsigned y;
+        ASSERT_EQ(std::sscanf(pair.first.c_str(), "z%u-%u-%u", &z, &x, &y), 3);
+        expectWithinOneUnit(pair.second, index.getTile(z, x, y).features);
+    }
+}
+
+TEST(CompactPoints, RejectOptionsBeyondResolution) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/single-geom.json"));
+
+    // one unit at maxZoom has to be at least 2^-30
+    Options options;
+    options.maxZoom = 18;
+    GeoJSONVT deepest{ geojson, options };
+
+    options.maxZoom = 19;
+    ASSERT_THROW((GeoJSONVT{ geojson, options }), std::runtime_error);
+
+    options.maxZoom = 17;
+    options.extent = 8192;
+    GeoJSONVT finer{ geojson, options };
+
+    options.extent = 16384;
+    ASSERT_THROW((GeoJSONVT{ geojson, options }), std::runtime_error);
+}
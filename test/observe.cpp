@@ -0,0 +1,260 @@
+// built with GEOJSONVT_OBSERVE defined, which changes Options, so apart from the other tests
+#include "util.hpp"
+#include <gtest/gtest.h>
+#include <mapbox/geojson.hpp>
+#include <mapbox/geojson_impl.hpp>
+#include <mapbox/geojsonvt.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace mapbox::geojsonvt;
+
+GTEST_API_ int main(int argc, char* argv[]) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
+
+class Recorder : public Observer {
+public:
+    void observe(const StageEvent& event) override {
+        const auto end = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(event);
+        ends.push_back(end);
+        threads.push_back(std::this_thread::get_id());
+    }
+
+    std::vector<StageEvent> of(const Stage stage) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<StageEvent> result;
+        for (const auto& event : events) {
+            if (event.stage == stage)
+                result.push_back(event);
+        }
+        return result;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.clear();
+        ends.clear();
+        threads.clear();
+    }
+
+    // the most threads that ran stages at the same time, each from the start of its first stage
+    // to the end of its last one
+    size_t peak() {
+        std::lock_guard<std::mutex> lock(mutex);
+        using time_point = std::chrono::steady_clock::time_point;
+        std::map<std::thread::id, std::pair<time_point, time_point>> spans;
+        for (size_t i = 0; i < events.size(); ++i) {
+            const time_point start = ends[i] - events[i].duration;
+            const auto span = spans.emplace(threads[i], std::make_pair(start, ends[i])).first;
+            span->second.first = std::min(span->second.first, start);
+            span->second.second = std::max(span->second.second, ends[i]);
+        }
+        std::vector<std::pair<time_point, int>> changes;
+        for (const auto& span : spans) {
+            changes.emplace_back(span.second.first, 1);
+            changes.emplace_back(span.second.second, -1);
+        }
+        std::sort(changes.begin(), changes.end());
+        size_t running = 0;
+        size_t most = 0;
+        for (const auto& change : changes) {
+            running += change.second;
+            most = std::max(most, running);
+        }
+        return most;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<StageEvent> events;
+    std::vector<std::chrono::steady_clock::time_point> ends;
+    std::vector<std::thread::id> threads;
+};
+
+// whether tile z/x/y is tile tz/tx/ty or one of the tiles above it
+bool onPath(const StageEvent& event, const uint8_t tz, const uint32_t tx, const uint32_t ty) {
+    return event.z <= tz && (tx >> (tz - event.z)) == event.x && (ty >> (tz - event.z)) == event.y;
+}
+
+const detail::InternalTile& internalTile(const GeoJSONVT& index, const StageEvent& event) {
+    return index.getInternalTiles().find(toID(event.z, event.x, event.y))->second;
+}
+
+TEST(Observer, BuildStages) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    const auto& features = geojson.get<mapbox::geojson::feature_collection>();
+
+    const auto recorder = std::make_shared<Recorder>();
+    Options options;
+    options.observer = recorder;
+    options.indexMaxPoints = 100;
+    GeoJSONVT index{ features, options };
+
+    const auto converted = recorder->of(Stage::convert);
+    ASSERT_EQ(converted.size(), 1u);
+    ASSERT_EQ(converted[0].z, 0);
+    ASSERT_EQ(converted[0].features, features.size());
+    ASSERT_GT(converted[0].points, 0u);
+
+    const auto wrapped = recorder->of(Stage::wrap);
+    ASSERT_EQ(wrapped.size(), 1u);
+    ASSERT_GE(wrapped[0].features, converted[0].features);
+    ASSERT_GE(wrapped[0].points, converted[0].points);
+
+    // every split makes four tiles under the top one
+    const auto splits = recorder->of(Stage::split);
+    ASSERT_GT(splits.size(), 0u);
+    ASSERT_EQ(index.total, 1 + 4 * splits.size());
+    for (const auto& split : splits) {
+        ASSERT_LT(split.z, options.indexMaxZoom);
+        for (uint8_t i = 0; i < 4; ++i) {
+            ASSERT_EQ(index.getInternalTiles().count(
+                          toID(split.z + 1, split.x * 2 + i / 2, split.y * 2 + i % 2)),
+                      1u);
+        }
+    }
+
+    // the tiles that were split were built on the way
+    const auto transforms = recorder->of(Stage::transform);
+    ASSERT_GE(transforms.size(), splits.size());
+    for (const auto& transform : transforms) {
+        ASSERT_EQ(transform.features, internalTile(index, transform).tile().features.size());
+    }
+    ASSERT_EQ(recorder->of(Stage::drillDown).empty(), true);
+}
+
+TEST(Observer, DrillDown) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    const auto recorder = std::make_shared<Recorder>();
+    Options options;
+    options.observer = recorder;
+    GeoJSONVT index{ geojson, options };
+    recorder->clear();
+
+    const auto total = index.total;
+    const Tile& tile = index.getTile(7, 37, 48);
+
+    const auto drills = recorder->of(Stage::drillDown);
+    ASSERT_EQ(drills.size(), 1u);
+    const auto& drill = drills[0];
+    ASSERT_EQ(onPath(drill, 7, 37, 48), true);
+    ASSERT_EQ(drill.depth, 7 - drill.z);
+    ASSERT_EQ(drill.features, index.total - total);
+
+    // only the tiles on the way down are split
+    const auto splits = recorder->of(Stage::split);
+    ASSERT_EQ(splits.size(), drill.depth);
+    for (const auto& split : splits) {
+        ASSERT_EQ(onPath(split, 6, 18, 24), true);
+        ASSERT_GE(split.z, drill.z);
+    }
+
+    bool built = false;
+    for (const auto& transform : recorder->of(Stage::transform)) {
+        if (transform.z == 7 && transform.x == 37 && transform.y == 48) {
+            ASSERT_EQ(transform.features, tile.features.size());
+            built = true;
+        }
+    }
+    ASSERT_EQ(built, true);
+}
+
+TEST(Observer, PathDrillDown) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    const auto recorder = std::make_shared<Recorder>();
+    Options options;
+    options.observer = recorder;
+    options.pathDrillDown = true;
+    GeoJSONVT index{ geojson, options };
+    recorder->clear();
+
+    index.getTile(7, 37, 48);
+    const auto drill = recorder->of(Stage::drillDown).at(0);
+    ASSERT_EQ(recorder->of(Stage::split).empty(), true);
+
+    // one clip per axis for every tile on the way down, which keep what was clipped
+    const auto columns = recorder->of(Stage::clipX);
+    const auto rows = recorder->of(Stage::clipY);
+    ASSERT_EQ(columns.size(), drill.depth);
+    ASSERT_EQ(rows.size(), drill.depth);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        ASSERT_EQ(onPath(columns[i], 7, 37, 48), true);
+        ASSERT_EQ(onPath(rows[i], 7, 37, 48), true);
+        ASSERT_GT(rows[i].z, drill.z);
+        ASSERT_EQ(rows[i].features, internalTile(index, rows[i]).source_features.size());
+    }
+}
+
+TEST(Observer, DirectDrillDown) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    const auto recorder = std::make_shared<Recorder>();
+    Options options;
+    options.observer = recorder;
+    options.directDrillDownPoints = 100000000;
+    GeoJSONVT index{ geojson, options };
+    recorder->clear();
+
+    index.getTile(7, 37, 48);
+    ASSERT_EQ(recorder->of(Stage::drillDown).size(), 1u);
+    ASSERT_EQ(recorder->of(Stage::split).empty(), true);
+
+    // clipped once per axis, straight to the requested tile
+    const auto columns = recorder->of(Stage::clipX);
+    const auto rows = recorder->of(Stage::clipY);
+    ASSERT_EQ(columns.size(), 1u);
+    ASSERT_EQ(rows.size(), 1u);
+    for (const auto& event : { columns[0], rows[0] }) {
+        ASSERT_EQ(event.z, 7);
+        ASSERT_EQ(event.x, 37u);
+        ASSERT_EQ(event.y, 48u);
+    }
+    const auto& clipped = internalTile(index, rows[0]).source_features;
+    ASSERT_EQ(rows[0].features, clipped.size());
+    uint64_t points = 0;
+    for (const auto& feature : clipped) {
+        points += feature.num_points;
+    }
+    ASSERT_EQ(rows[0].points, points);
+}
+
+TEST(Observer, BuildThreads) {
+    // circles all over the world, so that every quadrant has work to do
+    mapbox::geojson::feature_collection features;
+    for (int i = 0; i < 24; ++i) {
+        for (int j = 0; j < 12; ++j) {
+            mapbox::geometry::linear_ring<double> ring;
+            for (int k = 0; k <= 200; ++k) {
+                const double a = 2 * M_PI * (k % 200) / 200;
+                ring.push_back(
+                    { -172.5 + i * 15 + 5 * std::cos(a), -77.5 + j * 14 + 5 * std::sin(a) });
+            }
+            features.push_back({ mapbox::geometry::polygon<double>{ ring } });
+        }
+    }
+
+    for (const uint32_t threads : { 2u, 3u, 5u }) {
+        const auto recorder = std::make_shared<Recorder>();
+        Options options;
+        options.observer = recorder;
+        options.indexMaxPoints = 100;
+        options.threads = threads;
+        GeoJSONVT index{ features, options };
+        ASSERT_GT(index.total, 1000u);
+        ASSERT_LE(recorder->peak(), threads);
+    }
+}
@@ -10,9 +10,18 @@
 #include <mapbox/geometry.hpp>
 
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <numeric>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 #include <algorithm>
 
@@ -29,8 +38,24 @@ bool operator==(const detail::vt_point& a, const detail::vt_point& b) {
     return true;
 }
 
+TEST(Types, FixedPointCoordinates) {
+    const double resolution = 1.0 / (1 << 30);
+
+    for (const double value : { 0.0, 0.5, 0.123456789, 1.0, -0.015625, 1.999, -1.999 }) {
+        ASSERT_NEAR(value, double(detail::vt_fixed(value)), resolution / 2);
+    }
+
+    detail::vt_fixed x(0.75);
+    x += -1.0;
+    ASSERT_NEAR(-0.25, double(x), resolution / 2);
+
+    // values outside of the range saturate instead of wrapping around
+    ASSERT_LT(1.99, double(detail::vt_fixed(5.0)));
+    ASSERT_GT(-1.99, double(detail::vt_fixed(-5.0)));
+}
+
 TEST(Simplify, Points) {
-    std::vector<detail::vt_point> points = {
+    detail::vt_vector<detail::vt_point> points = {
         { 0.22455, 0.25015 }, { 0.22691, 0.24419 }, { 0.23331, 0.24145 }, { 0.23498, 0.23606 },
         { 0.24421, 0.23276 }, { 0.26259, 0.21531 }, { 0.26776, 0.21381 }, { 0.27357, 0.20184 },
         { 0.27312, 0.19216 }, { 0.27762, 0.18903 }, { 0.28036, 0.18141 }, { 0.28651, 0.17774 },
@@ -200,6 +225,155 @@ TEST(Clip, Points) {
     ASSERT_EQ(expected2, clipped2);
 }
 
+TEST(Clip, SharesUncutGeometry) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    const auto features =
+        detail::convert(geojson.get<mapbox::geojson::feature_collection>(), 0.0001, false);
+
+    // every feature lies within these bounds (Alaska reaches past the antimeridian), so nothing
+    // gets cut
+    const auto clipped = detail::clip<0>(features, -0.5, 1.5, -1, 2, false);
+
+    ASSERT_EQ(features.size(), clipped.size());
+    for (size_t i = 0; i < features.size(); ++i) {
+        ASSERT_EQ(features[i].geometry.get(), clipped[i].geometry.get());
+    }
+}
+
+TEST(Clip, SharesProperties) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    const auto features =
+        detail::convert(geojson.get<mapbox::geojson::feature_collection>(), 0.0001, false);
+
+    // cut along the -90th meridian, which runs through a number of states
+    const auto clipped = detail::clip<0>(features, 0.25, 1, -1, 2, false);
+
+    ASSERT_FALSE(clipped.empty());
+    for (const auto& feature : clipped) {
+        const auto it = std::find_if(features.begin(), features.end(), [&](const auto& source) {
+            return source.properties == feature.properties;
+        });
+        ASSERT_NE(it, features.end());
+    }
+}
+
+TEST(Clip, Quadrants) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    const auto features =
+        detail::convert(geojson.get<mapbox::geojson::feature_collection>(), 0.0001, false);
+
+    const double z2 = 2;
+    const uint32_t x = 0;
+    const uint32_t y = 0;
+    const double p = 0.5 * 64 / 4096;
+
+    const auto quadrants = detail::clipQuadrants(
+        features, (x - p) / z2, (x + 0.5 + p) / z2, (x + 0.5 - p) / z2, (x + 1 + p) / z2,
+        (y - p) / z2, (y + 0.5 + p) / z2, (y + 0.5 - p) / z2, (y + 1 + p) / z2, false);
+
+    const auto left = detail::clip<0>(features, (x - p) / z2, (x + 0.5 + p) / z2, -1, 2, false);
+    const auto right = detail::clip<0>(features, (x + 0.5 - p) / z2, (x + 1 + p) / z2, -1, 2, false);
+    const std::vector<detail::vt_features> expected{
+        detail::clip<1>(left, (y - p) / z2, (y + 0.5 + p) / z2, -1, 2, false),
+        detail::clip<1>(left, (y + 0.5 - p) / z2, (y + 1 + p) / z2, -1, 2, false),
+        detail::clip<1>(right, (y - p) / z2, (y + 0.5 + p) / z2, -1, 2, false),
+        detail::clip<1>(right, (y + 0.5 - p) / z2, (y + 1 + p) / z2, -1, 2, false)
+    };
+
+    for (size_t i = 0; i < 4; ++i) {
+        ASSERT_EQ(expected[i].size(), quadrants[i].size());
+        for (size_t j = 0; j < expected[i].size(); ++j) {
+            ASSERT_EQ(*expected[i][j].geometry, *quadrants[i][j].geometry);
+            ASSERT_EQ(expected[i][j].num_points, quadrants[i][j].num_points);
+        }
+    }
+}
+
+TEST(TileMap, FindEmplaceErase) {
+    detail::tile_map<std::string> map;
+    ASSERT_EQ(map.find(0) == map.end(), true);
+
+    const std::string& first = map.emplace(toID(0, 0, 0), "0/0/0").first->second;
+    for (uint32_t x = 0; x < 32; ++x) {
+        for (uint32_t y = 0; y < 32; ++y) {
+            ASSERT_EQ(map.emplace(toID(5, x, y), std::to_string(x) + "," + std::to_string(y)).second,
+                      true);
+        }
+    }
+    ASSERT_EQ(map.emplace(toID(5, 3, 4), "again").second, false);
+    ASSERT_EQ(map.size(), 1025u);
+    ASSERT_EQ(&first, &map.find(toID(0, 0, 0))->second); // tiles don't move as the map grows
+
+    for (uint32_t x = 0; x < 32; x += 2) {
+        for (uint32_t y = 0; y < 32; ++y) {
+            ASSERT_EQ(map.erase(toID(5, x, y)), 1u);
+        }
+    }
+    ASSERT_EQ(map.erase(toID(5, 0, 0)), 0u);
+    ASSERT_EQ(map.size(), 513u);
+
+    size_t visited = 0;
+    for (const auto& pair : map) {
+        ASSERT_EQ(map.find(pair.first)->second, pair.second);
+        ++visited;
+    }
+    ASSERT_EQ(visited, 513u);
+    ASSERT_EQ(map.find(toID(5, 3, 4))->second, "3,4");
+    ASSERT_EQ(map.count(toID(5, 4, 3)), 0u);
+
+    detail::tile_map<std::string> other;
+    other.emplace(toID(1, 1, 1), "1/1/1");
+    map.merge(std::move(other));
+    ASSERT_EQ(other.empty(), true);
+    ASSERT_EQ(map.find(toID(1, 1, 1))->second, "1/1/1");
+}
+
+TEST(Allocator, PoolReusesBlocks) {
+    using points = std::vector<detail::vt_point, detail::pool_allocator<detail::vt_point>>;
+
+    const detail::vt_point* first = nullptr;
+    {
+        points a{ { 0, 0 }, { 1, 1 }, { 2, 2 } };
+        first = a.data();
+    }
+
+    points b{ { 3, 3 }, { 4, 4 }, { 5, 5 } };
+    ASSERT_EQ(first, b.data());
+    ASSERT_EQ(4, b[1].x);
+
+    // blocks larger than the biggest size class come from operator new
+    points large(detail::block_pool::max_block / sizeof(detail::vt_point) + 1, { 1, 2 });
+    ASSERT_EQ(2, large.back().y);
+}
+
+TEST(Allocator, PoolRecyclesBlocksOfExitedThreads) {
+    const size_t size = 256;
+    std::vector<void*> freed;
+    std::thread([&] {
+        for (size_t i = 0; i < detail::block_pool::batch; ++i) {
+            freed.push_back(detail::block_pool::allocate(size));
+        }
+        for (void* p : freed) {
+            detail::block_pool::deallocate(p, size);
+        }
+    }).join();
+
+    // a new thread takes the blocks the last one handed back before carving a slab of its own
+    std::vector<void*> reused;
+    std::thread([&] {
+        for (size_t i = 0; i < detail::block_pool::batch; ++i) {
+            reused.push_back(detail::block_pool::allocate(size));
+        }
+        for (void* p : reused) {
+            detail::block_pool::deallocate(p, size);
+        }
+    }).join();
+
+    std::sort(freed.begin(), freed.end());
+    std::sort(reused.begin(), reused.end());
+    ASSERT_EQ(freed, reused);
+}
+
 TEST(GetTile, USStates) {
     const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
     GeoJSONVT index{ geojson.get<mapbox::geojson::feature_collection>() };
@@ -235,6 +409,757 @@ TEST(GetTile, GenerateIds) {
     ASSERT_EQ(features == expected, true);
 }
 
+TEST(GetTile, ParallelBuild) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 7;
+    options.indexMaxPoints = 200;
+
+    GeoJSONVT serial{ geojson, options };
+
+    options.threads = 4;
+    GeoJSONVT parallel{ geojson, options };
+
+    ASSERT_EQ(serial.total, parallel.total);
+    ASSERT_EQ(serial.stats, parallel.stats);
+    ASSERT_EQ(serial.getInternalTiles().size(), parallel.getInternalTiles().size());
+
+    for (const auto& pair : serial.getInternalTiles()) {
+        const auto it = parallel.getInternalTiles().find(pair.first);
+        ASSERT_NE(it, parallel.getInternalTiles().end());
+        ASSERT_EQ(pair.second.tile() == it->second.tile(), true);
+        ASSERT_EQ(pair.second.source_features.size(), it->second.source_features.size());
+    }
+}
+
+TEST(GetTile, LazyTiles) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.maxZoom = 14;
+    options.indexMaxZoom = 7;
+    options.indexMaxPoints = 200;
+    GeoJSONVT index{ geojson, options };
+
+    // only tiles that were split are built, right before their features are dropped
+    size_t leaves = 0;
+    for (const auto& pair : index.getInternalTiles()) {
+        const auto& tile = pair.second;
+        if (tile.num_points == 0)
+            continue;
+        ASSERT_EQ(tile.builtTile() != nullptr, tile.source_features.empty());
+        leaves += tile.source_features.empty() ? 0 : 1;
+    }
+    ASSERT_GT(leaves, 0u);
+
+    // the others are built when asked for, the same as when all tiles were built up front
+    const auto expected = parseJSONTiles(loadFile("test/fixtures/us-states-tiles.json"));
+    for (const auto& pair : index.getInternalTiles()) {
+        const auto& tile = pair.second;
+        if (tile.num_points == 0)
+            continue;
+        const std::string key = std::string("z") + std::to_string(tile.z) + "-" +
+                                std::to_string(tile.x) + "-" + std::to_string(tile.y);
+        ASSERT_EQ(expected.at(key) == index.getTile(tile.z, tile.x, tile.y).features, true);
+        ASSERT_NE(tile.builtTile(), nullptr);
+    }
+
+    // drilling down builds the requested tile and the ones on the way, but not their siblings
+    GeoJSONVT drilled{ geojson };
+    const auto& tile = drilled.getTile(7, 37, 48);
+    ASSERT_EQ(tile.features == parseJSONTile(loadFile("test/fixtures/us-states-z7-37-48.json")),
+              true);
+    size_t siblings = 0;
+    for (const auto& pair : drilled.getInternalTiles()) {
+        const auto& t = pair.second;
+        const bool onPath = (37u >> (7 - t.z)) == t.x && (48u >> (7 - t.z)) == t.y;
+        ASSERT_EQ(t.builtTile() != nullptr, onPath);
+        siblings += onPath ? 0 : 1;
+    }
+    ASSERT_GT(siblings, 0u);
+    ASSERT_EQ(drilled.getInternalTiles().find(toID(7, 37, 48))->second.builtTile(), &tile);
+}
+
+TEST(GetTile, FlatGeometry) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 7;
+    options.indexMaxPoints = 200;
+
+    GeoJSONVT nested{ geojson, options };
+
+    options.flatGeometry = true;
+    GeoJSONVT flat{ geojson, options };
+
+    const auto features =
+        detail::convert(geojson.get<mapbox::geojson::feature_collection>(), 0.0001, false, true);
+    ASSERT_EQ(features[0].geometry->is<detail::vt_flat_geometry>(), true);
+
+    ASSERT_EQ(nested.total, flat.total);
+    for (const auto& pair : nested.getInternalTiles()) {
+        const auto& tile = pair.second;
+        ASSERT_EQ(tile.tile() == flat.getTile(tile.z, tile.x, tile.y), true);
+    }
+    ASSERT_EQ(nested.getTile(10, 200, 380) == flat.getTile(10, 200, 380), true);
+}
+
+TEST(GetTile, TileRanges) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT index{ geojson };
+    index.getTile(7, 37, 48);
+
+    uint32_t count = 0;
+    uint64_t previous = 0;
+    index.forEachDescendant(0, 0, 0, [&](const detail::InternalTile& tile) {
+        const uint64_t key = detail::zOrderKey(tile.z, tile.x, tile.y);
+        ASSERT_LE(previous, key);
+        previous = key;
+        ++count;
+    });
+    ASSERT_EQ(count, index.total);
+
+    std::vector<uint8_t> zooms;
+    index.forEachDescendant(5, 9, 12, [&](const detail::InternalTile& tile) {
+        ASSERT_EQ(tile.x >> (tile.z - 5), 9u);
+        ASSERT_EQ(tile.y >> (tile.z - 5), 12u);
+        zooms.push_back(tile.z);
+    });
+    ASSERT_EQ(zooms, (std::vector<uint8_t>{ 5, 6, 7, 7, 7, 7, 6, 6, 6 }));
+
+    for (const auto& pair : index.stats) {
+        const uint32_t max = (1u << pair.first) - 1;
+        count = 0;
+        index.forEachTileInRange(pair.first, 0, 0, max, max,
+                                 [&](const detail::InternalTile&) { ++count; });
+        ASSERT_EQ(count, pair.second);
+    }
+
+    count = 0;
+    index.forEachTileInRange(4, 3, 5, 4, 6, [&](const detail::InternalTile& tile) {
+        ASSERT_EQ(tile.z, 4);
+        ASSERT_EQ(tile.x >= 3 && tile.x <= 4 && tile.y >= 5 && tile.y <= 6, true);
+        ++count;
+    });
+    ASSERT_EQ(count, 1u); // only 4/4/6 was generated on the way to 7/37/48
+
+    // tiles can only be ordered down to z29
+    Options options;
+    options.maxZoom = detail::z_order_max_zoom;
+    GeoJSONVT deepest{ geojson, options };
+    deepest.getTile(29, (37u << 22) + 1234, (48u << 22) + 5678);
+    ASSERT_EQ(deepest.getTiles({ toID(29, 37u << 22, 48u << 22) }).size(), 1u);
+    options.maxZoom = detail::z_order_max_zoom + 1;
+    ASSERT_THROW((GeoJSONVT{ geojson, options }), std::runtime_error);
+}
+
+TEST(GetTile, EvictsDrilledTiles) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 4;
+    options.indexMaxPoints = 1000;
+
+    GeoJSONVT unbounded{ geojson, options };
+
+    options.maxCachedTiles = 10;
+    GeoJSONVT bounded{ geojson, options };
+
+    struct TileCoordinate {
+        uint8_t z;
+        uint32_t x;
+        uint32_t y;
+    };
+
+    std::vector<TileCoordinate> requests;
+    for (uint32_t x = 36; x < 40; ++x) {
+        for (uint32_t y = 46; y < 50; ++y) {
+            requests.push_back({ 7, x, y });
+            requests.push_back({ 9, x * 4 + 1, y * 4 + 2 });
+        }
+    }
+
+    // go over the tiles twice, so that the second round rebuilds evicted ones
+    for (int round = 0; round < 2; ++round) {
+        for (const auto& t : requests) {
+            const auto& tile = bounded.getTile(t.z, t.x, t.y);
+            ASSERT_EQ(tile == unbounded.getTile(t.z, t.x, t.y), true);
+
+            uint32_t cached = 0;
+            for (const auto& pair : bounded.stats) {
+                if (pair.first > options.indexMaxZoom)
+                    cached += pair.second;
+            }
+            ASSERT_LE(cached, options.maxCachedTiles);
+        }
+    }
+}
+
+TEST(GetTile, PathDrillDown) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    GeoJSONVT full{ geojson };
+
+    Options options;
+    options.pathDrillDown = true;
+    GeoJSONVT path{ geojson, options };
+
+    ASSERT_EQ(path.getTile(7, 37, 48) == full.getTile(7, 37, 48), true);
+
+    // only the tiles on the way down were made, and each of them kept its geometry
+    ASSERT_EQ(full.stats[7], 4u);
+    ASSERT_EQ(path.stats[7], 1u);
+    ASSERT_EQ(path.stats[6], 1u);
+    const auto& parent = path.getInternalTiles().find(toID(6, 18, 24))->second;
+    ASSERT_EQ(parent.source_features.empty(), false);
+
+    // siblings are drilled down to later, from the closest tile on the way
+    ASSERT_EQ(path.getTile(7, 36, 49) == full.getTile(7, 36, 49), true);
+    ASSERT_EQ(path.getTile(8, 75, 97) == full.getTile(8, 75, 97), true);
+    ASSERT_EQ(path.getTile(9, 148, 192) == full.getTile(9, 148, 192), true);
+    ASSERT_EQ(path.getTile(11, 800, 400) == empty_tile, true);
+}
+
+TEST(GetTile, DirectDrillDown) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    GeoJSONVT full{ geojson };
+
+    Options options;
+    options.directDrillDownPoints = 1000000;
+    GeoJSONVT direct{ geojson, options };
+
+    for (const auto& t : { std::make_tuple(7, 37, 48), std::make_tuple(9, 148, 192),
+                           std::make_tuple(8, 75, 97) }) {
+        const auto& expected = full.getTile(std::get<0>(t), std::get<1>(t), std::get<2>(t));
+        const auto& tile = direct.getTile(std::get<0>(t), std::get<1>(t), std::get<2>(t));
+        ASSERT_EQ(tile.features.size(), expected.features.size());
+        ASSERT_EQ(tile.num_points, expected.num_points);
+    }
+
+    // only the requested tiles were made, each clipped from the closest tile above it
+    ASSERT_EQ(direct.stats.count(6), 0u);
+    ASSERT_EQ(direct.stats[7], 1u);
+    ASSERT_EQ(direct.stats[8], 1u);
+    ASSERT_EQ(direct.stats[9], 1u);
+    ASSERT_EQ(direct.getTile(11, 800, 400) == empty_tile, true);
+}
+
+TEST(GetTile, EmptyTiles) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    GeoJSONVT index{ geojson };
+
+    ASSERT_EQ(&empty_tile == &index.getTile(11, 800, 400), true);
+    const auto total = index.total;
+
+    // the empty tile found on the way down answers for everything under it
+    ASSERT_EQ(&empty_tile == &index.getTile(11, 801, 401), true);
+    ASSERT_EQ(&empty_tile == &index.getTile(14, 6400, 3200), true);
+    ASSERT_EQ(index.getTiles({ toID(12, 1601, 800), toID(13, 3200, 1603) })[1] == empty_tile, true);
+    ASSERT_EQ(index.getTileAsync(12, 1600, 801, [](std::function<void()>) {}).get() == empty_tile,
+              true);
+    ASSERT_EQ(index.total, total);
+
+    ASSERT_EQ(index.getTile(7, 37, 48).features.empty(), false);
+}
+
+TEST(GetTile, CoveredTiles) {
+    const mapbox::geometry::polygon<double> land{
+        { { -100, -60 }, { 100, -60 }, { 100, 60 }, { -100, 60 }, { -100, -60 } }
+    };
+    GeoJSONVT index{ feature_collection{ mapbox::feature::feature<double>{ land } } };
+
+    const auto& tile = index.getTile(10, 512, 512);
+    ASSERT_EQ(tile.features.size(), 1u);
+    const auto& ring = tile.features[0].geometry.get<mapbox::geometry::polygon<int16_t>>()[0];
+    ASSERT_EQ(ring.size(), 5u);
+    for (const auto& p : ring) {
+        ASSERT_EQ(p.x == -64 || p.x == 4160, true);
+        ASSERT_EQ(p.y == -64 || p.y == 4160, true);
+    }
+
+    // the tiles under a covered tile are never made, they all share the same square
+    const auto total = index.total;
+    ASSERT_EQ(&index.getTile(12, 2049, 2050) == &tile, true);
+    ASSERT_EQ(index.stats.count(10), 0u);
+    ASSERT_EQ(index.total, total);
+
+    ASSERT_EQ(index.getTile(12, 2000, 2100) == tile, true);
+}
+
+TEST(GetTile, ChangeFeatures) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    const auto& states = geojson.get<mapbox::geojson::feature_collection>();
+
+    GeoJSONVT index{ states };
+    index.getTile(7, 37, 48);
+    index.getTile(9, 148, 192);
+
+    // take New Jersey out, and put it back in after the others
+    const mapbox::feature::identifier id{ std::string("34") };
+    feature_collection others;
+    feature_collection newJersey;
+    for (const auto& feature : states) {
+        (feature.id == id ? newJersey : others).push_back(feature);
+    }
+    feature_collection reordered = others;
+    reordered.push_back(newJersey[0]);
+
+    const auto removed = index.removeFeatures({ id });
+    ASSERT_EQ(std::count(removed.begin(), removed.end(), toID(0, 0, 0)), 1);
+    ASSERT_EQ(std::count(removed.begin(), removed.end(), toID(7, 37, 48)), 1);
+
+    GeoJSONVT without{ others };
+    for (const auto& t : { std::make_tuple(0, 0, 0), std::make_tuple(7, 37, 48),
+                           std::make_tuple(8, 74, 97), std::make_tuple(9, 148, 192) }) {
+        ASSERT_EQ(index.getTile(std::get<0>(t), std::get<1>(t), std::get<2>(t)) ==
+                      without.getTile(std::get<0>(t), std::get<1>(t), std::get<2>(t)),
+                  true);
+    }
+
+    const auto added = index.addFeatures(newJersey);
+    ASSERT_EQ(std::count(added.begin(), added.end(), toID(7, 37, 48)), 1);
+
+    GeoJSONVT with{ reordered };
+    for (const auto& t : { std::make_tuple(0, 0, 0), std::make_tuple(7, 37, 48),
+                           std::make_tuple(8, 74, 97), std::make_tuple(10, 296, 387) }) {
+        ASSERT_EQ(index.getTile(std::get<0>(t), std::get<1>(t), std::get<2>(t)) ==
+                      with.getTile(std::get<0>(t), std::get<1>(t), std::get<2>(t)),
+                  true);
+    }
+
+    // updating a feature with the same geometry leaves the tiles as they are
+    const auto total = index.total;
+    index.updateFeatures(newJersey);
+    ASSERT_EQ(index.getTile(7, 37, 48) == with.getTile(7, 37, 48), true);
+    ASSERT_EQ(index.total, total);
+}
+
+// a path in the temporary directory for a file that's removed however the test ends
+struct TemporaryFile {
+    const std::string path;
+
+    explicit TemporaryFile(const std::string& name)
+        : path(std::string(std::getenv("TMPDIR") ? std::getenv("TMPDIR") : "/tmp") + "/" + name) {
+    }
+
+    ~TemporaryFile() {
+        std::remove(path.c_str());
+    }
+
+    void write(const std::string& bytes) const {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+};
+
+TEST(GetTile, Snapshot) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    const TemporaryFile file("geojsonvt-snapshot-test.snapshot");
+    const std::string& path = file.path;
+
+    Options options;
+    options.indexMaxZoom = 4;
+    GeoJSONVT index{ geojson, options };
+    index.getTile(7, 37, 48);
+    index.save(path);
+
+    // tiles are only read from the file when they're requested
+    auto opened = GeoJSONVT::open(path);
+    ASSERT_EQ(opened.options.indexMaxZoom, 4);
+    ASSERT_LT(opened.total, index.total);
+
+    for (const auto& t : { std::make_tuple(0, 0, 0), std::make_tuple(4, 4, 6),
+                           std::make_tuple(7, 37, 48), std::make_tuple(9, 148, 192) }) {
+        ASSERT_EQ(opened.getTile(std::get<0>(t), std::get<1>(t), std::get<2>(t)) ==
+                      index.getTile(std::get<0>(t), std::get<1>(t), std::get<2>(t)),
+                  true);
+    }
+
+    std::remove(path.c_str());
+    ASSERT_THROW(GeoJSONVT::open(path), std::runtime_error);
+}
+
+TEST(GetTile, DamagedSnapshot) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    const TemporaryFile file("geojsonvt-damaged-test.snapshot");
+
+    Options options;
+    options.indexMaxZoom = 4;
+    GeoJSONVT index{ geojson, options };
+    index.save(file.path);
+    const std::string bytes = loadFile(file.path);
+
+    // a copy of the file with a header number replaced
+    const auto patched = [&](const size_t at, const uint64_t value) {
+        std::string copy = bytes;
+        std::memcpy(&copy[at], &value, sizeof(value));
+        return copy;
+    };
+    const auto number = [&](const size_t at) {
+        uint64_t value;
+        std::memcpy(&value, &bytes[at], sizeof(value));
+        return value;
+    };
+    const auto loadAll = [&](GeoJSONVT& opened) {
+        for (const auto& pair : index.getInternalTiles()) {
+            opened.getTile(pair.second.z, pair.second.x, pair.second.y);
+        }
+    };
+
+    // too short for a header, or for the sections the header points to
+    file.write(bytes.substr(0, 10));
+    ASSERT_THROW(GeoJSONVT::open(file.path), std::runtime_error);
+    file.write(bytes.substr(0, detail::snapshot_header_size + 8));
+    ASSERT_THROW(GeoJSONVT::open(file.path), std::runtime_error);
+    file.write(patched(24, bytes.size()));
+    ASSERT_THROW(GeoJSONVT::open(file.path), std::runtime_error);
+
+    // the last tile record cut short
+    file.write(bytes.substr(0, bytes.size() - 1));
+    {
+        auto opened = GeoJSONVT::open(file.path);
+        ASSERT_THROW(loadAll(opened), std::runtime_error);
+    }
+
+    // features referring to geometries or properties past the end of their sections
+    file.write(patched(32, 0));
+    {
+        auto opened = GeoJSONVT::open(file.path);
+        ASSERT_THROW(opened.getTile(4, 4, 6), std::runtime_error);
+    }
+    file.write(patched(48, 0));
+    {
+        auto opened = GeoJSONVT::open(file.path);
+        ASSERT_THROW(opened.getTile(4, 4, 6), std::runtime_error);
+    }
+
+    // geometry records said to start past the end of the file
+    std::string outside = bytes;
+    for (uint64_t i = 0; i < number(32); ++i) {
+        const uint64_t end = bytes.size();
+        std::memcpy(&outside[number(40) + i * 8], &end, sizeof(end));
+    }
+    file.write(outside);
+    {
+        auto opened = GeoJSONVT::open(file.path);
+        ASSERT_THROW(opened.getTile(4, 4, 6), std::runtime_error);
+    }
+
+    // intact, it still loads
+    file.write(bytes);
+    auto opened = GeoJSONVT::open(file.path);
+    loadAll(opened);
+    ASSERT_EQ(opened.getTile(4, 4, 6) == index.getTile(4, 4, 6), true);
+}
+
+TEST(GetTile, MemoryUsage) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    Options options;
+    options.indexMaxPoints = 1000;
+    GeoJSONVT index{ geojson, options };
+    const auto built = index.memoryUsage(3);
+    ASSERT_GT(built.total.points, 0u);
+    ASSERT_GT(built.total.properties, 0u);
+    ASSERT_EQ(built.zooms.size(), index.stats.size());
+    ASSERT_EQ(built.heaviest.size(), 3u);
+    ASSERT_GE(built.heaviest[0].bytes.total(), built.heaviest[1].bytes.total());
+    ASSERT_GE(built.heaviest[1].bytes.total(), built.heaviest[2].bytes.total());
+
+    size_t zooms = 0;
+    for (const auto& pair : built.zooms) {
+        zooms += pair.second.total();
+    }
+    ASSERT_LT(zooms, built.total.total());
+
+    // output tiles are only counted once they're built
+    index.getTile(7, 37, 48);
+    const auto drilled = index.memoryUsage();
+    ASSERT_GT(drilled.total.features, built.total.features);
+    ASSERT_GT(drilled.zooms.at(7).features, 0u);
+
+    // strings count what they keep outside of the string object
+    ASSERT_EQ(detail::heapBytes(std::string()), 0u);
+    const std::string long_string(100, 'a');
+    ASSERT_EQ(detail::heapBytes(long_string), long_string.capacity() + 1);
+#if defined(_GLIBCXX_USE_CXX11_ABI) && !_GLIBCXX_USE_CXX11_ABI
+    // the old libstdc++ strings keep even short ones on the heap
+    ASSERT_EQ(detail::heapBytes(std::string("ab")), std::string("ab").capacity() + 1);
+#endif
+}
+
+TEST(GetTile, RequestStats) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    GeoJSONVT index{ geojson };
+    ASSERT_EQ(index.requestStats().zooms.empty(), true);
+
+    index.getTile(7, 37, 48);
+    index.getTile(7, 37, 48);
+    index.getTile(11, 800, 400);
+    index.getTile(11, 800, 400);
+    index.getTiles({ toID(0, 0, 0) });
+
+    const auto stats = index.requestStats();
+    const auto& z7 = stats.zooms.at(7);
+    ASSERT_EQ(z7.drillDowns, 1u);
+    ASSERT_EQ(z7.hits, 1u);
+    ASSERT_EQ(z7.drillLevels[0], 0u);
+    ASSERT_EQ(std::accumulate(z7.drillLevels.begin(), z7.drillLevels.end(), uint64_t(0)), 1u);
+
+    // the second request for an empty tile is answered without looking for a parent
+    const auto& z11 = stats.zooms.at(11);
+    ASSERT_GE(z11.empty, 1u);
+    ASSERT_EQ(z11.hits + z11.drillDowns + z11.empty, 2u);
+
+    // getTiles counts its tiles, but not its time
+    ASSERT_EQ(stats.zooms.at(0).hits, 1u);
+    ASSERT_EQ(stats.zooms.at(0).latency.count(), 0u);
+    ASSERT_EQ(stats.total.latency.count(), 4u);
+    ASSERT_LE(stats.total.latency.percentile(0.5), stats.total.latency.percentile(0.99));
+    ASSERT_GT(stats.total.latency.percentile(1).count(), 0);
+
+    // latencies fall in buckets at most an eighth of their lower bound wide
+    for (const uint64_t ns : { 0u, 7u, 8u, 1000u, 123456789u }) {
+        const size_t i = LatencyHistogram::bucket(ns);
+        ASSERT_LE(LatencyHistogram::lowerBound(i), ns);
+        ASSERT_GT(LatencyHistogram::lowerBound(i + 1), ns);
+        ASSERT_LE((LatencyHistogram::lowerBound(i + 1) - LatencyHistogram::lowerBound(i)) * 8,
+                  std::max<uint64_t>(LatencyHistogram::lowerBound(i), 8));
+    }
+}
+
+TEST(GetTile, BuildLimits) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    Options options;
+    options.indexMaxPoints = 1000;
+    GeoJSONVT full{ geojson, options };
+    ASSERT_EQ(full.degraded() == BuildLimit::none, true);
+
+    options.maxIndexTiles = 10;
+    GeoJSONVT fewer{ geojson, options };
+    ASSERT_EQ(fewer.degraded() == BuildLimit::tiles, true);
+    ASSERT_LE(fewer.total, 10u);
+
+    options.maxIndexTiles = 0;
+    options.maxIndexBytes = 1;
+    GeoJSONVT smaller{ geojson, options };
+    ASSERT_EQ(smaller.degraded() == BuildLimit::bytes, true);
+    ASSERT_EQ(smaller.total, 1u);
+
+    // the tiles the build stopped at are drilled down from when requested
+    for (const auto& index : { &fewer, &smaller }) {
+        ASSERT_EQ(index->getTile(7, 37, 48) == full.getTile(7, 37, 48), true);
+        ASSERT_EQ(index->getTile(5, 9, 12) == full.getTile(5, 9, 12), true);
+        ASSERT_EQ(&empty_tile == &index->getTile(11, 800, 400), true);
+    }
+}
+
+TEST(GetTile, ConcurrentRequests) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    GeoJSONVT serial{ geojson };
+    GeoJSONVT shared{ geojson };
+
+    struct TileCoordinate {
+        uint8_t z;
+        uint32_t x;
+        uint32_t y;
+    };
+
+    std::vector<TileCoordinate> requests;
+    for (uint32_t x = 36; x < 40; ++x) {
+        for (uint32_t y = 46; y < 50; ++y) {
+            requests.push_back({ 7, x, y });
+            requests.push_back({ 8, x * 2 + 1, y * 2 });
+            requests.push_back({ 9, x * 4 + 1, y * 4 + 2 });
+        }
+    }
+
+    // every thread asks for the same tiles in a different order, so that most of them are
+    // requested by several threads at once, while they are still being built
+    const size_t threads = 8;
+    std::vector<std::vector<Tile>> results(threads);
+    std::vector<std::thread> workers;
+
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (size_t i = 0; i < requests.size(); ++i) {
+                const auto& r = requests[(i * (t + 1) + t) % requests.size()];
+                results[t].push_back(shared.getTile(r.z, r.x, r.y));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (size_t t = 0; t < threads; ++t) {
+        for (size_t i = 0; i < requests.size(); ++i) {
+            const auto& r = requests[(i * (t + 1) + t) % requests.size()];
+            ASSERT_EQ(results[t][i] == serial.getTile(r.z, r.x, r.y), true);
+        }
+    }
+
+    ASSERT_EQ(shared.stats, serial.stats);
+    ASSERT_EQ(shared.total, serial.total);
+    ASSERT_EQ(shared.tileCount(), serial.total);
+    ASSERT_EQ(shared.tileCount(9), serial.stats[9]);
+}
+
+TEST(GetTile, BatchRequests) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    GeoJSONVT serial{ geojson };
+
+    // a viewport of z9 tiles, plus a few tiles at other zooms, an existing one and a duplicate
+    std::vector<uint64_t> ids;
+    for (uint32_t x = 148; x < 154; ++x) {
+        for (uint32_t y = 192; y < 197; ++y) {
+            ids.push_back(toID(9, x, y));
+        }
+    }
+    ids.push_back(toID(7, 37, 48));
+    ids.push_back(toID(4, 0, 0));
+    ids.push_back(toID(0, 0, 0));
+    ids.push_back(toID(9, 150, 194));
+
+    for (const uint32_t threads : { 1u, 4u }) {
+        GeoJSONVT index{ geojson };
+        const auto tiles = index.getTiles(ids, threads);
+        ASSERT_EQ(tiles.size(), ids.size());
+
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const uint8_t z = ids[i] % 32;
+            const uint32_t x = (ids[i] >> 5) % (1u << z);
+            const uint32_t y = (ids[i] >> 5) >> z;
+            ASSERT_EQ(tiles[i] == serial.getTile(z, x, y), true);
+        }
+
+        // the shared ancestors were only sliced into the tiles needed for the batch
+        ASSERT_EQ(index.stats, serial.stats);
+    }
+}
+
+TEST(GetTile, GenerateAll) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 3;
+    options.indexMaxPoints = 1000;
+
+    GeoJSONVT serial{ geojson, options };
+
+    for (const uint32_t threads : { 1u, 4u }) {
+        GeoJSONVT index{ geojson, options };
+        const auto total = index.total;
+
+        std::mutex mutex;
+        std::map<uint64_t, Tile> generated;
+        index.generateAll(2, 6, [&](uint8_t z, uint32_t x, uint32_t y, const Tile& tile) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ASSERT_EQ(generated.count(toID(z, x, y)), 0u);
+            generated.emplace(toID(z, x, y), tile);
+        }, threads);
+
+        // the tiles are built without being added to the index
+        ASSERT_EQ(index.total, total);
+
+        // every tile with data is generated exactly once, and nothing else
+        for (uint8_t z = 0; z <= 6; ++z) {
+            for (uint32_t x = 0; x < (1u << z); ++x) {
+                for (uint32_t y = 0; y < (1u << z); ++y) {
+                    const auto& tile = serial.getTile(z, x, y);
+                    const auto it = generated.find(toID(z, x, y));
+                    if (z < 2 || tile.features.empty()) {
+                        ASSERT_EQ(it == generated.end(), true);
+                    } else {
+                        ASSERT_EQ(it != generated.end(), true);
+                        ASSERT_EQ(it->second == tile, true);
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(GetTile, GenerateAllAfterEviction) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+    Options options;
+    options.indexMaxZoom = 3;
+    options.indexMaxPoints = 1000;
+
+    GeoJSONVT serial{ geojson, options };
+
+    options.maxCachedTiles = 8;
+    GeoJSONVT index{ geojson, options };
+
+    // drill down all over the states, so that tiles are evicted while their parents stay
+    for (uint32_t x = 8; x < 20; ++x) {
+        for (uint32_t y = 20; y < 28; ++y) {
+            index.getTile(6, x, y);
+        }
+    }
+
+    std::map<uint64_t, Tile> generated;
+    index.generateAll(2, 6, [&](uint8_t z, uint32_t x, uint32_t y, const Tile& tile) {
+        ASSERT_EQ(generated.count(toID(z, x, y)), 0u);
+        generated.emplace(toID(z, x, y), tile);
+    });
+
+    // tiles under evicted ones are cut again from the closest tile above them with geometry
+    for (uint8_t z = 2; z <= 6; ++z) {
+        for (uint32_t x = 0; x < (1u << z); ++x) {
+            for (uint32_t y = 0; y < (1u << z); ++y) {
+                const auto& tile = serial.getTile(z, x, y);
+                const auto it = generated.find(toID(z, x, y));
+                ASSERT_EQ(it != generated.end(), !tile.features.empty());
+                if (it != generated.end())
+                    ASSERT_EQ(it->second == tile, true);
+            }
+        }
+    }
+}
+
+TEST(GetTile, AsyncRequests) {
+    const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/us-states.json"));
+
+    GeoJSONVT serial{ geojson };
+    GeoJSONVT index{ geojson };
+
+    // queue the work, to run it later on threads of our own
+    std::vector<std::function<void()>> queued;
+    const auto executor = [&](std::function<void()> task) { queued.push_back(std::move(task)); };
+
+    // tiles that exist already don't need the executor
+    auto root = index.getTileAsync(0, 0, 0, executor);
+    ASSERT_EQ(queued.size(), 0u);
+    ASSERT_EQ(root.get() == serial.getTile(0, 0, 0), true);
+
+    // requests for the same tile share a single task while it's pending
+    auto first = index.getTileAsync(7, 37, 48, executor);
+    auto second = index.getTileAsync(7, 37, 48, executor);
+    auto wrapped = index.getTileAsync(7, 37 + 128, 48, executor);
+    auto other = index.getTileAsync(8, 75, 97, executor);
+    ASSERT_EQ(queued.size(), 2u);
+
+    std::vector<std::thread> workers;
+    for (auto& task : queued) {
+        workers.emplace_back(task);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    ASSERT_EQ(first.get() == serial.getTile(7, 37, 48), true);
+    ASSERT_EQ(second.get() == first.get(), true);
+    ASSERT_EQ(wrapped.get() == first.get(), true);
+    ASSERT_EQ(other.get() == serial.getTile(8, 75, 97), true);
+
+    // once built, the tile is served directly
+    queued.clear();
+    ASSERT_EQ(index.getTileAsync(7, 37, 48, executor).get() == first.get(), true);
+    ASSERT_EQ(queued.size(), 0u);
+}
+
 TEST(GetTile, AntimeridianTriangle) {
     const auto geojson = mapbox::geojson::parse(loadFile("test/fixtures/dateline-triangle.json"));
 
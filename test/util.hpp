@@ -44,6 +44,10 @@ std::ostream& operator<<(std::ostream& os, const std::vector<T>& items) {
     return os << "]";
 }
 
+std::ostream& operator<<(std::ostream& os, const vt_flat_geometry& geom) {
+    return os << geom.points;
+}
+
 } // namespace detail
 } // namespace geojsonvt
 } // namespace mapbox